@@ -17,6 +17,8 @@
 #include "Bot.h"
 #include "BotSocket.h"
 #include "BotMgr.h"
+#include "BotIoThread.h"
+#include "BotLoginRamp.h"
 #include "BotProfile.h"
 #include "BotLogging.h"
 #include "HMAC.h"
@@ -24,7 +26,10 @@
 #include "BehaviorTree.h"
 
 #include "boost/asio/high_resolution_timer.hpp"
+#include <algorithm>
 #include <chrono>
+#include <functional>
+#include <random>
 
 using namespace std::literals::chrono_literals;
 
@@ -45,6 +50,11 @@ std::string const& Bot::GetUsername() const
     return m_username;
 }
 
+uint64_t Bot::GetSourceHint() const
+{
+    return std::hash<std::string>()(m_username);
+}
+
 std::string const& Bot::GetPassword() const
 {
     return m_password;
@@ -54,15 +64,22 @@ void Bot::QueueDisconnect()
 {
     if (!m_disconnected)
     {
-        m_thread->m_bot_count--;
-        m_thread->m_queuedRemoves.push_back(m_username);
+        m_disconnected = true;
+        sBotMgr->StopBot(m_username);
     }
-    m_disconnected = true;
 }
 
 void Bot::DisconnectNow()
 {
     m_isLoggedIn = false;
+    m_migrateTarget = nullptr;
+    m_thread->m_timers.Cancel(m_timeoutTimer);
+    m_timeoutTimer = 0;
+    m_timeoutPhase = BotTimeoutPhase::NONE;
+    m_thread->m_timers.Cancel(m_reconnectTimer);
+    m_reconnectTimer = 0;
+    m_loginAttempt.reset();
+    EndHandshake(false);
     if (m_worldSocket.has_value() || m_authSocket.has_value())
     {
         BOT_LOG_DEBUG("bot","Logging out %s",m_username.c_str());
@@ -70,6 +87,7 @@ void Bot::DisconnectNow()
 
     if (m_worldSocket.has_value())
     {
+        m_thread->m_pipelinedBots.erase(m_worldSocket->GetIoConnection());
         m_worldSocket.value().Close();
     }
 
@@ -80,7 +98,11 @@ void Bot::DisconnectNow()
 
     m_worldSocket.reset();
     m_authSocket.reset();
-    m_encrypt.reset();
+    if (m_encryptStream != BotArc4Engine::NONE)
+    {
+        m_thread->m_arc4.Destroy(m_encryptStream);
+        m_encryptStream = BotArc4Engine::NONE;
+    }
     m_decrypt.reset();
 }
 
@@ -99,23 +121,80 @@ BotProfile Bot::GetEvents()
     return m_cached_events;
 }
 
+Bot& Bot::SetImpairment(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime)
+{
+    m_impairment = BotImpairment::Create(latency, jitter, bandwidth, stallChance, stallTime);
+    if (m_authSocket.has_value())
+    {
+        ApplyImpairment(m_authSocket.value());
+    }
+    if (m_worldSocket.has_value())
+    {
+        ApplyImpairment(m_worldSocket.value());
+    }
+    return *this;
+}
+
+Bot& Bot::ClearImpairment()
+{
+    m_impairment.reset();
+    if (m_authSocket.has_value())
+    {
+        ApplyImpairment(m_authSocket.value());
+    }
+    if (m_worldSocket.has_value())
+    {
+        ApplyImpairment(m_worldSocket.value());
+    }
+    return *this;
+}
+
+void Bot::ApplyImpairment(BotSocket& socket)
+{
+    std::optional<BotImpairment> const& impairment = m_impairment.has_value() || !m_cached_events.m_storage
+        ? m_impairment
+        : m_cached_events.m_storage->m_impairment;
+    if (impairment.has_value())
+    {
+        socket.SetImpairment(impairment.value(), m_thread->m_timers, m_thread->m_random);
+    }
+    else
+    {
+        socket.ClearImpairment();
+    }
+}
+
 void Bot::SetEncryptionKey(std::array<uint8_t, 40> const& key)
 {
-    m_encrypt.emplace();
-    m_decrypt.emplace();
+    if (m_encryptStream != BotArc4Engine::NONE)
+    {
+        m_thread->m_arc4.Destroy(m_encryptStream);
+    }
+    m_decrypt = std::make_unique<Trinity::Crypto::ARC4>();
     uint8 ClientEncryptionKey[] = { 0xC2, 0xB3, 0x72, 0x3C, 0xC6, 0xAE, 0xD9, 0xB5, 0x34, 0x3C, 0x53, 0xEE, 0x2F, 0x43, 0x67, 0xCE };
-    m_encrypt.value().Init(Trinity::Crypto::HMAC_SHA1::GetDigestOf(ClientEncryptionKey, key));
+    auto encryptKey = Trinity::Crypto::HMAC_SHA1::GetDigestOf(ClientEncryptionKey, key);
+    m_encryptStream = m_thread->m_arc4.Create(encryptKey.data(), encryptKey.size());
     uint8 ClientDecryptionKey[] = { 0xCC, 0x98, 0xAE, 0x04, 0xE8, 0x97, 0xEA, 0xCA, 0x12, 0xDD, 0xC0, 0x93, 0x42, 0x91, 0x53, 0x57 };
-    m_decrypt.value().Init(Trinity::Crypto::HMAC_SHA1::GetDigestOf(ClientDecryptionKey, key));
+    m_decrypt->Init(Trinity::Crypto::HMAC_SHA1::GetDigestOf(ClientDecryptionKey, key));
     std::array<uint8_t, 1024> arr;
-    m_encrypt.value().UpdateData(arr);
-    m_decrypt.value().UpdateData(arr);
+    m_decrypt->UpdateData(arr);
+}
+
+// the timer wheel only advances once per tick, too coarse for handshake latency
+static uint64_t GetHandshakeTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void Bot::Connect()
 {
     DisconnectNow();
     BOT_LOG_DEBUG("bot","Logging in %s", GetUsername().c_str());
+    m_loginCancelled = false;
+    m_loginAttempt = std::make_shared<bool>(true);
+    // only called for bots the login ramp admitted
+    m_handshakeStart = std::max<uint64_t>(GetHandshakeTime(), 1);
     Authenticate();
 }
 
@@ -128,36 +207,272 @@ void Bot::UnloadScripts()
 }
 
 void Bot::LoadScripts()
+{
+    LoadBehavior();
+    FIRE(OnLoad, m_cached_events, {}, *this);
+}
+
+void Bot::LoadBehavior()
 {
     m_behavior = nullptr;
     m_cached_events = m_thread->m_events->GetEvents(m_events);
     if (m_cached_events.m_storage->m_root)
     {
         m_behavior = std::make_unique<TreeExecutor<Bot, std::monostate, std::monostate>>(m_thread->m_events->GetBehaviorTreeContext(),m_cached_events.m_storage->m_root);
-        m_thread->m_botsWithAI[this->m_username] = this;
     }
-    FIRE(OnLoad, m_cached_events, {}, *this);
+    m_thread->m_bots.UpdateBehavior(m_id);
 }
 
 void Bot::ConnectionLoop()
 {
+    m_reconnectAttempts = 0;
+    EndHandshake(true);
     FIRE(OnLoggedIn, GetEvents(), {}, *this);
+    OnWorldRead();
+    ArmTimeout(BotTimeoutPhase::IDLE);
+    if (sBotMgr->IsPipelined())
+    {
+        return StartPipeline();
+    }
+    ReadWorld();
+}
+
+void Bot::ReadWorld()
+{
     promise::doWhile([this](promise::DeferLoop& loop) {
-        if (!m_worldSocket.has_value())
+        // packets can already be buffered from the login handshake
+        if (!HandleWorldPackets())
         {
             return loop.doBreak();
         }
 
-        WorldPacket::ReadWorldPacket(this)
-            .then([=](WorldPacket packet) {
-                FIRE_ID(uint32_t(packet.GetOpcode()), OnWorldPacket, GetEvents(), { packet.Reset(); }, * this, packet)
+        std::weak_ptr<bool> lifetime = m_worldSocket->GetLifetime();
+        m_worldSocket->ReadSome()
+            .then([=]() {
+                OnWorldRead();
+                if (m_migrateTarget)
+                {
+                    // the new thread handles what was just read
+                    loop.doBreak();
+                    return ContinueMigration();
+                }
                 loop.doContinue();
             })
-            .fail([=]() { loop.doBreak(); })
+            .fail([=]() {
+                loop.doBreak();
+                // the read was cancelled for a migration
+                if (!lifetime.expired() && m_migrateTarget)
+                {
+                    ContinueMigration();
+                }
+            })
             ;
     });
 }
 
+void Bot::ArmTimeout(BotTimeoutPhase phase)
+{
+    m_thread->m_timers.Cancel(m_timeoutTimer);
+    m_timeoutTimer = 0;
+    m_timeoutPhase = phase;
+    uint32_t timeout = m_thread->GetTimeout(phase);
+    if (timeout > 0)
+    {
+        m_timeoutTimer = m_thread->m_timers.Schedule(timeout, [this]() { m_timeoutTimer = 0; OnTimeout(); });
+    }
+}
+
+void Bot::OnTimeout()
+{
+    uint32_t timeout = m_thread->GetTimeout(m_timeoutPhase);
+    if (m_timeoutPhase == BotTimeoutPhase::IDLE)
+    {
+        // reads only record a timestamp, the deadline is moved here
+        uint64_t idle = m_thread->m_timers.GetTime() - m_lastWorldRead;
+        if (idle < timeout)
+        {
+            m_timeoutTimer = m_thread->m_timers.Schedule(timeout - idle, [this]() { m_timeoutTimer = 0; OnTimeout(); });
+            return;
+        }
+    }
+
+    static char const* phaseNames[] = { "none", "connect", "handshake", "idle" };
+    BOT_LOG_INFO("bot", "%s timed out after %u ms (%s), disconnecting", m_username.c_str(), timeout, phaseNames[uint32_t(m_timeoutPhase)]);
+    DisconnectNow();
+    if (m_disconnected)
+    {
+        return;
+    }
+    if (HasReconnectPolicy())
+    {
+        ScheduleReconnect();
+    }
+    else if (m_thread->m_requeueOnTimeout)
+    {
+        m_thread->QueueLogin(m_id);
+    }
+}
+
+void Bot::OnLoginFailed()
+{
+    // the failed attempt must not time out on top of this
+    m_thread->m_timers.Cancel(m_timeoutTimer);
+    m_timeoutTimer = 0;
+    m_timeoutPhase = BotTimeoutPhase::NONE;
+    EndHandshake(false);
+    if (m_loginCancelled || m_disconnected)
+    {
+        return;
+    }
+    ScheduleReconnect();
+}
+
+void Bot::EndHandshake(bool success)
+{
+    if (m_handshakeStart == 0)
+    {
+        return;
+    }
+    uint64_t time = GetHandshakeTime();
+    // reconnects that did not come from StartBot count from their admission
+    uint64_t queued = m_loginQueuedTime > 0 ? m_loginQueuedTime : m_handshakeStart;
+    sBotLoginRamp->Release(time - m_handshakeStart, time - queued, success);
+    m_handshakeStart = 0;
+    if (success)
+    {
+        m_loginQueuedTime = 0;
+    }
+}
+
+bool Bot::HasReconnectPolicy() const
+{
+    return m_cached_events.m_storage && m_cached_events.m_storage->m_reconnect.has_value();
+}
+
+bool Bot::ScheduleReconnect()
+{
+    if (!HasReconnectPolicy())
+    {
+        return false;
+    }
+
+    BotReconnectPolicy const& policy = m_cached_events.m_storage->m_reconnect.value();
+    if (policy.m_maxAttempts > 0 && m_reconnectAttempts >= policy.m_maxAttempts)
+    {
+        BOT_LOG_INFO("bot", "%s failed to log in %u times, giving up", m_username.c_str(), m_reconnectAttempts);
+        return false;
+    }
+
+    // exponential backoff, with a random part taken off so bots that failed together come back apart
+    uint64_t delay = std::min<uint64_t>(uint64_t(policy.m_baseDelay) << std::min(m_reconnectAttempts, 31u), policy.m_maxDelay);
+    std::uniform_real_distribution<float> jitter(0.0f, policy.m_jitter);
+    delay -= uint64_t(delay * jitter(m_thread->m_random));
+    m_reconnectAttempts++;
+
+    BOT_LOG_DEBUG("bot", "%s reconnecting in %llu ms (attempt %u)", m_username.c_str(), (unsigned long long)delay, m_reconnectAttempts);
+    m_thread->m_timers.Cancel(m_reconnectTimer);
+    m_reconnectTimer = m_thread->m_timers.Schedule(delay, [this]() {
+        m_reconnectTimer = 0;
+        if (!m_disconnected)
+        {
+            // retries wait for admission like any other login
+            m_thread->QueueLogin(m_id);
+        }
+    });
+    return true;
+}
+
+void Bot::OnWorldRead()
+{
+    m_lastWorldRead = m_thread->m_timers.GetTime();
+}
+
+bool Bot::HandleWorldPackets()
+{
+    std::optional<WorldPacket> packet;
+    while (m_worldSocket.has_value() && WorldPacket::FrameWorldPacket(*this, packet))
+    {
+        // the packet views the receive buffer, if a handler disconnects the next one would read freed memory
+        if (BotProfileMgr::GetStorage(GetEvents())->OnWorldPacket_callbacks.count(uint32_t(packet->GetOpcode())) > 1)
+        {
+            packet = WorldPacket(packet.value());
+        }
+        HandleWorldPacket(packet.value());
+        packet.reset();
+    }
+    return m_worldSocket.has_value() && m_worldSocket->IsOpen();
+}
+
+void Bot::HandleWorldPacket(WorldPacket& packet)
+{
+    uint64_t start = BotThread::GetCostClock();
+    FIRE_ID(uint32_t(packet.GetOpcode()), OnWorldPacket, GetEvents(), { packet.Reset(); }, * this, packet)
+    uint64_t cost = BotThread::GetCostClock() - start;
+    m_cost += cost;
+    m_thread->m_packetCost += cost;
+}
+
+void Bot::StartPipeline()
+{
+    // whatever the handshake already buffered is handled here, the rest on the io thread
+    if (!HandleWorldPackets())
+    {
+        return;
+    }
+
+    BotSocket& socket = m_worldSocket.value();
+    if (!socket.IsIdle())
+    {
+        // the native socket can only change hands without writes in flight
+        std::weak_ptr<bool> lifetime = socket.GetLifetime();
+        boost::asio::post(m_thread->m_context, [this, lifetime]() {
+            if (!lifetime.expired())
+            {
+                StartPipeline();
+            }
+        });
+        return;
+    }
+
+    uint64_t connection = BotIoThread::NextConnectionId();
+    socket.HandOff(sBotMgr->GetIoChannel(*m_thread, connection), connection, std::move(m_decrypt));
+    m_thread->m_pipelinedBots[connection] = this;
+}
+
+bool Bot::CanMigrateLive() const
+{
+    return m_isLoggedIn && m_handshakeStart == 0 && m_worldSocket.has_value();
+}
+
+void Bot::ContinueMigration()
+{
+    BotSocket& world = m_worldSocket.value();
+    bool ready = world.IsIdle()
+        && (!m_authSocket.has_value() || m_authSocket->IsIdle())
+        // a bot that just moved here has to get the events its old thread passes on first
+        && m_thread->m_heldIoEvents.find(world.GetIoConnection()) == m_thread->m_heldIoEvents.end()
+        // StartPipeline is still waiting to hand the socket to an io thread
+        && !(sBotMgr->IsPipelined() && world.GetIoConnection() == 0 && world.IsOpen());
+    if (!ready)
+    {
+        std::weak_ptr<bool> lifetime = world.GetLifetime();
+        m_thread->m_timers.Schedule(0, [this, lifetime]() {
+            if (!lifetime.expired() && m_migrateTarget)
+            {
+                ContinueMigration();
+            }
+        });
+        return;
+    }
+
+    if (world.IsReading())
+    {
+        // ReadWorld calls back once the read finished
+        return world.CancelRead();
+    }
+    m_thread->ReleaseBot(this, m_migrateTarget, true);
+}
+
 bool Bot::IsLoggedIn()
 {
     return m_isLoggedIn;
@@ -17,6 +17,8 @@
 #pragma once
 
 #include "BotSocket.h"
+#include "BotArc4.h"
+#include "BotSlotTable.h"
 #include "BotProfile.h"
 
 #include <sol/sol.hpp>
@@ -50,10 +52,19 @@ struct RealmInfo
     uint8_t m_major_version;
     uint8_t m_minor_version;
     uint8_t m_bugfix_version;
-    uint8_t m_build;
+    uint16_t m_build;
 };
 #pragma pack(pop)
 
+// What a bot is waiting for, each phase has its own timeout (Bots.*Timeout)
+enum class BotTimeoutPhase : uint8_t
+{
+    NONE,
+    CONNECT,
+    HANDSHAKE,
+    IDLE
+};
+
 class Bot
 {
 public:
@@ -71,13 +82,19 @@ public:
     BotSocket& GetAuthSocket2();
     BotSocket& GetWorldSocket2();
     BotProfile GetEvents();
+    // Overrides the profile's impairment, applies to open connections immediately
+    Bot& SetImpairment(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime);
+    Bot& ClearImpairment();
     friend class WorldPacket;
     friend class BotThread;
     friend class BotMgr;
     friend class BotProfileLua;
     friend class AuthMgr;
+    friend class BotSlotTable;
 private:
     BotThread* m_thread;
+    // slot in m_thread->m_bots
+    BotId m_id;
     std::string m_username;
     std::string m_password;
     std::string m_authserverIp;
@@ -86,17 +103,81 @@ private:
     std::unique_ptr<TreeExecutor<Bot,std::monostate,std::monostate>> m_behavior;
     std::string m_events;
     BotProfile m_cached_events;
-    std::optional<Trinity::Crypto::ARC4> m_encrypt;
-    std::optional<Trinity::Crypto::ARC4> m_decrypt;
+    // stream in the thread's BotArc4Engine
+    uint32_t m_encryptStream = BotArc4Engine::NONE;
+    // handed over to the io thread in pipelined mode
+    std::unique_ptr<Trinity::Crypto::ARC4> m_decrypt;
     std::array<uint8_t, 20> m_m2Hash;
     std::array<uint8_t, 40> m_keyData;
     std::optional<BotSocket> m_authSocket;
     std::optional<BotSocket> m_worldSocket;
     RealmInfo m_realm;
+    BotTimeoutPhase m_timeoutPhase = BotTimeoutPhase::NONE;
+    uint64_t m_timeoutTimer = 0;
+    uint64_t m_lastWorldRead = 0;
+    // failed logins since the last successful one
+    uint32_t m_reconnectAttempts = 0;
+    uint64_t m_reconnectTimer = 0;
+    // set when a profile cancelled the login, which is not retried
+    bool m_loginCancelled = false;
+    // reset by DisconnectNow, failures of an older login attempt are ignored
+    std::shared_ptr<bool> m_loginAttempt;
+    // when the login ramp admitted the running handshake, 0 if there is none
+    uint64_t m_handshakeStart = 0;
+    // when StartBot queued the login, kept across retries until the bot is in world
+    uint64_t m_loginQueuedTime = 0;
+    // m_keyData holds the session key of a completed logon, which the authserver accepts for a reconnect
+    bool m_hasSessionKey = false;
+    // set while the bot waits to move to another BotThread with its connections
+    BotThread* m_migrateTarget = nullptr;
+    // ns spent on behavior and packets since the balancer last looked
+    uint64_t m_cost = 0;
+    std::optional<BotImpairment> m_impairment;
     boost::asio::io_context m_ioc;
     sol::table m_data;
     void LoadScripts();
+    // LoadScripts without firing OnLoad, for a bot that keeps its data
+    void LoadBehavior();
     void UnloadScripts();
     void Authenticate();
+    // Picks the source address when Network.SourceAddressSelection is "hash"
+    uint64_t GetSourceHint() const;
+    bool CloseAuthConnection();
+    promise::Promise ConnectAuthServer();
+    // Full SRP6 logon
+    promise::Promise LogonAuthServer();
+    // Reconnect challenge/proof with the session key of the last logon
+    promise::Promise ReconnectAuthServer();
+#ifdef BOTS_AUTH_COROUTINES
+    boost::asio::awaitable<void> AuthenticateCoroutine();
+    boost::asio::awaitable<void> ConnectAuthServerAsync();
+    // Returns false if a profile cancelled the logon
+    boost::asio::awaitable<bool> LogonAuthServerAsync();
+    boost::asio::awaitable<void> ReconnectAuthServerAsync();
+#endif
     void ConnectionLoop();
+    // Non-pipelined mode: reads the world connection until it fails or the bot moves away
+    void ReadWorld();
+    // Replaces the pending timeout with the one for "phase"
+    void ArmTimeout(BotTimeoutPhase phase);
+    void OnTimeout();
+    void OnLoginFailed();
+    // Gives the handshake slot back to the login ramp
+    void EndHandshake(bool success);
+    // Retries the login according to the profile's reconnect policy, false if it has none or it is exhausted
+    bool ScheduleReconnect();
+    bool HasReconnectPolicy() const;
+    // Gives a new socket the bot's or the profile's impairment
+    void ApplyImpairment(BotSocket& socket);
+    // Idle timeouts are pushed back by received world data
+    void OnWorldRead();
+    // Dispatches every complete packet in the world receive buffer, returns false if the connection is gone
+    bool HandleWorldPackets();
+    void HandleWorldPacket(WorldPacket& packet);
+    // Pipelined mode: moves the world connection to an io thread once it is idle
+    void StartPipeline();
+    // Logged in bots move with their connections, the others log in again on the new thread
+    bool CanMigrateLive() const;
+    // Waits for writes and the pending read to finish, then hands the bot to m_migrateTarget
+    void ContinueMigration();
 };
@@ -66,3 +66,19 @@ std::vector<BotAccount> GetBotAccounts(std::vector<uint32_t> bot)
     }
     return accounts;
 }
+
+std::vector<BotAccount> GetAllBotAccounts()
+{
+    std::vector<BotAccount> accounts;
+    if (!json.has_value())
+    {
+        return accounts;
+    }
+    for (auto const& obj : json.value())
+    {
+        std::string username = obj["username"];
+        std::string password = obj["password"];
+        accounts.emplace_back(username, password);
+    }
+    return accounts;
+}
@@ -17,3 +17,4 @@ private:
 void ReloadAccounts();
 BotAccount GetBotAccount(uint32_t bot);
 std::vector<BotAccount> GetBotAccounts(std::vector<uint32_t> bot);
+std::vector<BotAccount> GetAllBotAccounts();
@@ -0,0 +1,249 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotArc4.h"
+#include "BotLogging.h"
+#include "ARC4.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <random>
+
+static thread_local BotArc4Engine* currentEngine = nullptr;
+
+uint32_t BotArc4Engine::Allocate()
+{
+    uint32_t stream;
+    if (m_free.size() > 0)
+    {
+        stream = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        stream = uint32_t(m_states.size());
+        m_states.emplace_back();
+    }
+    return stream;
+}
+
+uint32_t BotArc4Engine::Create(uint8_t const* key, size_t size)
+{
+    uint32_t stream = Allocate();
+    State& state = m_states[stream];
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        state.m_s[i] = uint8_t(i);
+    }
+    uint8_t j = 0;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        j += state.m_s[i] + key[i % size];
+        std::swap(state.m_s[i], state.m_s[j]);
+    }
+    state.m_i = 0;
+    state.m_j = 0;
+
+    uint8_t drop[1024] = {};
+    Queue(stream, drop, sizeof(drop));
+    Flush();
+    return stream;
+}
+
+void BotArc4Engine::Destroy(uint32_t stream)
+{
+    m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [=](Job const& job) { return job.m_stream == stream; }), m_jobs.end());
+    m_free.push_back(stream);
+}
+
+BotArc4Engine::State const& BotArc4Engine::Export(uint32_t stream) const
+{
+    return m_states[stream];
+}
+
+uint32_t BotArc4Engine::Import(State const& state)
+{
+    uint32_t stream = Allocate();
+    m_states[stream] = state;
+    return stream;
+}
+
+void BotArc4Engine::Queue(uint32_t stream, uint8_t* data, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    m_jobs.push_back({ stream, uint32_t(size), data });
+}
+
+void BotArc4Engine::Run(State& state, uint8_t* data, uint32_t size)
+{
+    uint8_t i = state.m_i;
+    uint8_t j = state.m_j;
+    for (uint32_t n = 0; n < size; ++n)
+    {
+        uint8_t si = state.m_s[++i];
+        j += si;
+        uint8_t sj = state.m_s[j];
+        state.m_s[i] = sj;
+        state.m_s[j] = si;
+        data[n] ^= state.m_s[uint8_t(si + sj)];
+    }
+    state.m_i = i;
+    state.m_j = j;
+}
+
+void BotArc4Engine::RunPair(State& a, uint8_t* dataA, State& b, uint8_t* dataB, uint32_t size)
+{
+    // the two dependency chains are written out side by side, wider groups spill
+    // registers and ended up slower than running the streams one after the other
+    uint8_t ia = a.m_i;
+    uint8_t ja = a.m_j;
+    uint8_t ib = b.m_i;
+    uint8_t jb = b.m_j;
+    for (uint32_t n = 0; n < size; ++n)
+    {
+        uint8_t sa = a.m_s[++ia];
+        uint8_t sb = b.m_s[++ib];
+        ja += sa;
+        jb += sb;
+        uint8_t ta = a.m_s[ja];
+        uint8_t tb = b.m_s[jb];
+        a.m_s[ia] = ta;
+        b.m_s[ib] = tb;
+        a.m_s[ja] = sa;
+        b.m_s[jb] = sb;
+        dataA[n] ^= a.m_s[uint8_t(sa + ta)];
+        dataB[n] ^= b.m_s[uint8_t(sb + tb)];
+    }
+    a.m_i = ia;
+    a.m_j = ja;
+    b.m_i = ib;
+    b.m_j = jb;
+}
+
+void BotArc4Engine::Flush()
+{
+    // jobs run in the order they were queued, two of different streams at a time
+    size_t i = 0;
+    while (i < m_jobs.size())
+    {
+        Job const& first = m_jobs[i];
+        if (i + 1 < m_jobs.size() && m_jobs[i + 1].m_stream != first.m_stream)
+        {
+            Job const& second = m_jobs[i + 1];
+            State& a = m_states[first.m_stream];
+            State& b = m_states[second.m_stream];
+            uint32_t size = std::min(first.m_size, second.m_size);
+            RunPair(a, first.m_data, b, second.m_data, size);
+            Run(a, first.m_data + size, first.m_size - size);
+            Run(b, second.m_data + size, second.m_size - size);
+            i += 2;
+        }
+        else
+        {
+            Run(m_states[first.m_stream], first.m_data, first.m_size);
+            i += 1;
+        }
+    }
+    m_jobs.clear();
+}
+
+void BotArc4Engine::FlushCurrent()
+{
+    if (currentEngine)
+    {
+        currentEngine->Flush();
+    }
+}
+
+void BotArc4Engine::SetCurrent(BotArc4Engine* engine)
+{
+    currentEngine = engine;
+}
+
+BotArc4Engine* BotArc4Engine::GetCurrent()
+{
+    return currentEngine;
+}
+
+void RunArc4Benchmark(uint32_t streams, uint32_t packets)
+{
+    std::minstd_rand random(streams);
+    std::vector<std::array<uint8_t, 20>> keys(streams);
+    for (std::array<uint8_t, 20>& key : keys)
+    {
+        for (uint8_t& byte : key)
+        {
+            byte = uint8_t(random());
+        }
+    }
+    std::vector<uint8_t> plain(size_t(streams) * 6);
+    for (uint8_t& byte : plain)
+    {
+        byte = uint8_t(random());
+    }
+
+    std::vector<std::unique_ptr<Trinity::Crypto::ARC4>> evp(streams);
+    BotArc4Engine engine;
+    std::vector<uint32_t> engineStreams(streams);
+    std::array<uint8_t, 1024> drop;
+    for (uint32_t i = 0; i < streams; ++i)
+    {
+        evp[i] = std::make_unique<Trinity::Crypto::ARC4>();
+        evp[i]->Init(keys[i]);
+        evp[i]->UpdateData(drop);
+        engineStreams[i] = engine.Create(keys[i].data(), keys[i].size());
+    }
+
+    // one tick: every stream sends a packet
+    std::vector<uint8_t> evpHeaders;
+    std::vector<uint8_t> engineHeaders;
+    auto measure = [&](char const* name, std::vector<uint8_t>& headers, auto tick) {
+        double seconds = 0;
+        for (uint32_t p = 0; p < packets; ++p)
+        {
+            headers = plain;
+            auto start = std::chrono::steady_clock::now();
+            tick(headers);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double total = double(streams) * packets;
+        BOT_LOG_INFO("arc4bench", "%s: %.0f headers in %.3fs, %.1f ns per header", name, total, seconds, seconds * 1e9 / total);
+    };
+    measure("EVP per call", evpHeaders, [&](std::vector<uint8_t>& headers) {
+        for (uint32_t i = 0; i < streams; ++i)
+        {
+            evp[i]->UpdateData(headers.data() + i * 6, 6);
+        }
+    });
+    measure("BotArc4Engine", engineHeaders, [&](std::vector<uint8_t>& headers) {
+        for (uint32_t i = 0; i < streams; ++i)
+        {
+            engine.Queue(engineStreams[i], headers.data() + i * 6, 6);
+        }
+        engine.Flush();
+    });
+
+    // both ran the same number of bytes through each stream, so the last tick has to agree
+    if (evpHeaders != engineHeaders)
+    {
+        BOT_LOG_ERROR("arc4bench", "BotArc4Engine output does not match EVP");
+    }
+}
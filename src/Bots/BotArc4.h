@@ -0,0 +1,70 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// RC4 states of every bot on a BotThread in one array. World packet headers are only
+// 6 bytes, so encrypting each with its own EVP call is mostly call overhead. Instead
+// Send queues the header and the first socket flush of the thread encrypts everything
+// queued in one pass, stepping two streams side by side so their byte loops overlap.
+// Each BotThread owns one and installs it as the current engine of its OS thread.
+class BotArc4Engine
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct State
+    {
+        uint8_t m_s[256];
+        uint8_t m_i;
+        uint8_t m_j;
+    };
+    // Key schedule followed by the 1024 byte drop of the world protocol
+    uint32_t Create(uint8_t const* key, size_t size);
+    // Pending data of the stream is left as it is
+    void Destroy(uint32_t stream);
+    // "data" is encrypted in place by the next Flush and has to stay valid until then.
+    // Data queued for the same stream is encrypted in order.
+    void Queue(uint32_t stream, uint8_t* data, size_t size);
+    void Flush();
+    // Moves a stream to another engine: Export after a Flush, Import on the other thread
+    State const& Export(uint32_t stream) const;
+    uint32_t Import(State const& state);
+    // Flushes the current threads engine, if it has one
+    static void FlushCurrent();
+    static void SetCurrent(BotArc4Engine* engine);
+    static BotArc4Engine* GetCurrent();
+private:
+    uint32_t Allocate();
+    struct Job
+    {
+        uint32_t m_stream;
+        uint32_t m_size;
+        uint8_t* m_data;
+    };
+    static void Run(State& state, uint8_t* data, uint32_t size);
+    static void RunPair(State& a, uint8_t* dataA, State& b, uint8_t* dataB, uint32_t size);
+    std::vector<State> m_states;
+    std::vector<uint32_t> m_free;
+    std::vector<Job> m_jobs;
+};
+
+// Encrypts "packets" headers on each of "streams" streams, per call through
+// Trinity::Crypto::ARC4 (OpenSSL EVP) against queued through BotArc4Engine
+void RunArc4Benchmark(uint32_t streams, uint32_t packets);
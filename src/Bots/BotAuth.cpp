@@ -20,6 +20,9 @@
 #include "BotMutable.h"
 #include "BotProfile.h"
 #include "BotLogging.h"
+#include "BotCrypto.h"
+#include "BotSrp6.h"
+#include "BotCredentialCache.h"
 
 #include "BigNumber.h"
 #include "CryptoHash.h"
@@ -31,6 +34,11 @@
 #include <algorithm>
 #include <stdexcept>
 #include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <map>
 
 enum class AuthResult : uint8_t
 {
@@ -81,6 +89,8 @@ enum class AuthCommand : uint8_t
 {
     LOGON_CHALLENGE   = 0x00,
     LOGON_PROOF       = 0x01,
+    RECONNECT_CHALLENGE = 0x02,
+    RECONNECT_PROOF   = 0x03,
     REALM_LIST        = 0x10,
     TRANSFER_INITIATE = 0x30,
     TRANSFER_DATA     = 0x31,
@@ -95,6 +105,8 @@ std::string AuthCommandString(AuthCommand result)
     {
     case AuthCommand::LOGON_CHALLENGE: return "LOGON_CHALLENGE";
     case AuthCommand::LOGON_PROOF: return "LOGON_PROOF";
+    case AuthCommand::RECONNECT_CHALLENGE: return "RECONNECT_CHALLENGE";
+    case AuthCommand::RECONNECT_PROOF: return "RECONNECT_PROOF";
     case AuthCommand::REALM_LIST: return "REALM_LIST";
     case AuthCommand::TRANSFER_INITIATE: return "TRANSFER_INITIATE";
     case AuthCommand::TRANSFER_DATA: return "TRANSFER_DATA";
@@ -109,8 +121,9 @@ std::string AuthCommandString(AuthCommand result)
 #pragma pack(push,1)
 struct ClientAuthChallenge
 {
-    ClientAuthChallenge(std::string const& username, uint32_t ip)
-        : m_packetSize(30 + username.size())
+    ClientAuthChallenge(std::string const& username, uint32_t ip, AuthCommand command)
+        : m_command(command)
+        , m_packetSize(30 + username.size())
         , m_ip(ip)
         , m_nameLen(username.size())
     {}
@@ -136,6 +149,23 @@ struct ServerAuthProof
     uint16_t unk3;
 };
 
+// Answer to a reconnect challenge, after the command and result
+struct ServerReconnectChallenge
+{
+    std::array<uint8_t, 16> m_reconnectProof;
+    std::array<uint8_t, 16> m_versionChallenge;
+};
+
+struct ClientReconnectProof
+{
+    AuthCommand m_command = AuthCommand::RECONNECT_PROOF;
+    std::array<uint8_t, 16> m_r1;
+    // SHA1(username, R1, reconnect proof, session key)
+    std::array<uint8_t, 20> m_r2;
+    std::array<uint8_t, 20> m_r3 = {};
+    uint8_t m_numberOfKeys = 0;
+};
+
 struct ClientAuthProof
 {
     std::vector<uint8_t> packet;
@@ -151,8 +181,11 @@ struct ClientRequestRealmlist
 
 struct ServerRealmlistHeader
 {
-    std::array<uint8_t, 7> unk;
-    uint16_t size;
+    uint8_t cmd;
+    // bytes following this field, including the realm count and footer
+    uint16_t packetSize;
+    uint32_t unk;
+    uint16_t count;
 };
 #pragma pack(pop)
 
@@ -290,128 +323,585 @@ std::array<uint8_t, T> getRandomBytes()
     return arr;
 }
 
-static promise::Promise ReadRealmInfo(BotSocket* socket)
+// Size of the realm list that follows the header (realms and footer)
+static size_t RealmlistBodySize(ServerRealmlistHeader const& header)
+{
+    size_t consumed = sizeof(header.unk) + sizeof(header.count);
+    return header.packetSize > consumed ? header.packetSize - consumed : 0;
+}
+
+// Parses "count" realms from a complete realm list body, returns false if it is truncated
+static bool ParseRealmList(uint8_t const* data, size_t size, uint16_t count, std::vector<RealmInfo>& realms)
+{
+    size_t pos = 0;
+    bool ok = true;
+    auto read = [&](auto value) {
+        if (size - pos < sizeof(value))
+        {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    };
+    auto readCString = [&]() {
+        char const* start = reinterpret_cast<char const*>(data + pos);
+        void const* end = memchr(start, 0, size - pos);
+        if (!end)
+        {
+            ok = false;
+            return std::string();
+        }
+        std::string value(start, static_cast<char const*>(end));
+        pos += value.size() + 1;
+        return value;
+    };
+
+    realms.reserve(count);
+    for (uint16_t i = 0; i < count && ok; ++i)
+    {
+        RealmInfo realm;
+        realm.m_type = read(uint8_t());
+        realm.m_locked = read(uint8_t());
+        realm.m_flags = read(uint8_t());
+        realm.m_name = readCString();
+        std::string tokens = readCString();
+        size_t off = tokens.find(':');
+        if (off == std::string::npos)
+        {
+            realm.m_port = 8085;
+            realm.m_address = tokens;
+        }
+        else
+        {
+            realm.m_address = tokens.substr(0, off);
+            realm.m_port = uint16_t(std::strtoul(tokens.c_str() + off + 1, nullptr, 10));
+        }
+        realm.m_population = read(float());
+        realm.m_load = read(uint8_t());
+        realm.m_timezone = read(uint8_t());
+        realm.m_id = read(uint8_t());
+        if (realm.m_flags & 4)
+        {
+            realm.m_major_version = read(uint8_t());
+            realm.m_minor_version = read(uint8_t());
+            realm.m_bugfix_version = read(uint8_t());
+            realm.m_build = read(uint16_t());
+        }
+        realms.push_back(std::move(realm));
+    }
+
+    if (!ok)
+    {
+        BOT_LOG_ERROR("Auth", "Truncated realm list");
+    }
+    return ok;
+}
+
+// The steps below are shared by the promise and coroutine handshakes
+
+static AuthPacket BuildLogonChallenge(std::string const& username, uint32_t ip, AuthCommand command = AuthCommand::LOGON_CHALLENGE)
 {
-    RealmInfo* realm = new RealmInfo();
-    return socket->ReadPOD<uint8_t>()
-        .then([=](uint8_t type) { realm->m_type = type; return socket->ReadPOD<uint8_t>(); })
-        .then([=](uint8_t locked) { realm->m_locked = locked; return socket->ReadPOD<uint8_t>(); })
-        .then([=](uint8_t flags) { realm->m_flags = flags; return socket->ReadCString(); })
-        .then([=](std::string const& name) { realm->m_name = name; return socket->ReadCString(); })
-        .then([=](std::string const& tokens) {
-            size_t off = tokens.find(':');
-            if (off == std::string::npos)
+    return AuthPacket(MergeVec(ClientAuthChallenge(username, ip, command), username));
+}
+
+// Proves we still know the session key of our last logon
+static AuthPacket BuildReconnectProof(std::string const& username, ServerReconnectChallenge const& challenge, std::array<uint8_t, 40> const& keyData)
+{
+    ClientReconnectProof proof;
+    proof.m_r1 = Trinity::Crypto::GetRandomBytes<16>();
+    proof.m_r2 = BotSha1::GetDigestOf(username, proof.m_r1, challenge.m_reconnectProof, keyData);
+    return AuthPacket(MergeVec(proof));
+}
+
+struct LogonProof
+{
+    AuthPacket m_packet;
+    std::array<uint8_t, 20> m_m2Hash;
+    std::array<uint8_t, 40> m_keyData;
+};
+
+// BigNumber version, for moduli BotSrp6 can not handle and as the benchmark baseline
+// "secret" is the client's private value a, only replaced if it can not be used
+static LogonProof ComputeLogonProofGeneric(std::string const& username, std::string const& password, ServerAuthChallenge const& serverChallenge, std::array<uint8_t, 19> const& secret)
+{
+    std::string authString = username + ":" + password;
+    std::transform(authString.begin(), authString.end(), authString.begin(), [](uint8_t c) {return std::toupper(c); });
+    // this is just a bunch of math
+    BigNumber k(3);
+    BigNumber B = CreateBigNumber<32>(serverChallenge.m_B);
+    BigNumber g(serverChallenge.m_g);
+    BigNumber N = CreateBigNumber<32>(serverChallenge.m_N);
+    BigNumber salt = CreateBigNumber<32>(serverChallenge.m_salt);
+    BigNumber unk1 = CreateBigNumber<16>(serverChallenge.m_unk3);
+    BigNumber x = CreateBigNumber(SHA1(serverChallenge.m_salt, SHA1(authString)));
+    BigNumber a(secret);
+    BigNumber A = g.ModExp(a, N);
+    while (A.ModExp(1, N) == 0)
+    {
+        a = BigNumber(getRandomBytes<19>());
+        A = g.ModExp(a, N);
+    }
+    BigNumber u = CreateBigNumber(SHA1(A, B));
+    BigNumber S = ((B + k * (N - g.ModExp(x, N))) % N).ModExp(a + (u * x), N);
+    std::vector<uint8_t> sData = MergeVec(S);
+    if (sData.size() < 32)
+        sData.resize(32);
+    std::array<uint8_t, 40> keyData;
+    std::array<uint8_t, 16> temp;
+    for (int i = 0; i < 16; ++i)
+        temp[i] = sData[i * 2];
+    std::array<uint8_t, 20> keyHash = SHA1(temp);
+    for (int i = 0; i < 20; ++i)
+        keyData[int64_t(i) * 2] = keyHash[i];
+    for (int i = 0; i < 16; ++i)
+        temp[i] = sData[int64_t(i) * 2 + 1];
+    keyHash = SHA1(temp);
+    for (int i = 0; i < 20; ++i)
+        keyData[int64_t(i) * 2 + 1] = keyHash[i];
+    BigNumber key(keyData);
+    std::vector<uint8_t> gnHash(20);
+    auto nHash = SHA1(N);
+    for (int i = 0; i < 20; ++i)
+        gnHash[i] = nHash[i];
+    auto gHash = SHA1(g);
+    for (int i = 0; i < 20; ++i)
+        gnHash[i] ^= gHash[i];
+    auto m1Hash = SHA1(gnHash, SHA1(username), serverChallenge.m_salt, A, B, key);
+    return {
+        AuthPacket(MergeVec(uint8_t(AuthCommand::LOGON_PROOF), A, m1Hash, std::vector<uint8_t>(22))),
+        SHA1(A, m1Hash, keyData),
+        keyData
+    };
+}
+
+static LogonProof ComputeLogonProofGeneric(std::string const& username, std::string const& password, ServerAuthChallenge const& serverChallenge)
+{
+    return ComputeLogonProofGeneric(username, password, serverChallenge, getRandomBytes<19>());
+}
+
+static LogonProof ComputeLogonProof(std::string const& username, std::string const& password, ServerAuthChallenge const& serverChallenge)
+{
+    BotSrp6::Proof proof;
+    BotCredentialCache::Credentials credentials = sBotCredentialCache->Get(username, password, serverChallenge);
+    BotUInt256 const* verifier = credentials.m_hasVerifier ? &credentials.m_verifier : nullptr;
+    if (!BotSrp6::ComputeProof(username, serverChallenge, credentials.m_x, verifier, getRandomBytes<19>(), proof))
+    {
+        return ComputeLogonProofGeneric(username, password, serverChallenge);
+    }
+    AuthPacket packet(MergeVec(uint8_t(AuthCommand::LOGON_PROOF), std::vector<uint8_t>(proof.m_A.begin(), proof.m_A.begin() + proof.m_aSize), proof.m_m1Hash, std::vector<uint8_t>(22)));
+    return { std::move(packet), proof.m_m2Hash, proof.m_keyData };
+}
+
+void RunSrp6Benchmark(uint32_t count)
+{
+    // a challenge as TrinityCore sends it
+    static uint8_t const N[] = {
+        0xB7, 0x9B, 0x3E, 0x2A, 0x87, 0x82, 0x3C, 0xAB, 0x8F, 0x5E, 0xBF, 0xBF, 0x8E, 0xB1, 0x01, 0x08,
+        0x53, 0x50, 0x06, 0x29, 0x8B, 0x5B, 0xAD, 0xBD, 0x5B, 0x53, 0xE1, 0x89, 0x5E, 0x64, 0x4B, 0x89
+    };
+    ServerAuthChallenge challenge = {};
+    challenge.m_gLen = 1;
+    challenge.m_g = 7;
+    challenge.m_nLen = 32;
+    memcpy(challenge.m_N.data(), N, sizeof(N));
+    std::minstd_rand random(count);
+    for (uint8_t& byte : challenge.m_salt)
+    {
+        byte = uint8_t(random());
+    }
+    for (uint8_t& byte : challenge.m_B)
+    {
+        byte = uint8_t(random());
+    }
+    // below N
+    challenge.m_B[31] = 0x40;
+
+    auto measure = [&](char const* name, auto compute) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            compute("BENCH" + std::to_string(i % 64), "PASSWORD");
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        BOT_LOG_INFO("srpbench", "%s: %u proofs in %.3fs, %.0f proofs/s on one core", name, count, seconds, count / seconds);
+    };
+    measure("BigNumber", [&](std::string const& username, std::string const& password) {
+        return ComputeLogonProofGeneric(username, password, challenge);
+    });
+    measure("Fixed-width", [&](std::string const& username, std::string const& password) {
+        BotSrp6::Proof proof;
+        std::array<uint8_t, 20> x = BotSrp6::ComputeX(username, password, challenge.m_salt);
+        return BotSrp6::ComputeProof(username, challenge, x, nullptr, getRandomBytes<19>(), proof);
+    });
+    // what a cache hit leaves, computed here so the live cache and its file do not get the bench accounts
+    std::map<std::string, BotCredentialCache::Credentials> cached;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        BotCredentialCache::Credentials& credentials = cached["BENCH" + std::to_string(i)];
+        credentials.m_x = BotSrp6::ComputeX("BENCH" + std::to_string(i), "PASSWORD", challenge.m_salt);
+        credentials.m_hasVerifier = BotSrp6::ComputeVerifier(challenge, credentials.m_x, credentials.m_verifier);
+    }
+    measure("Fixed-width, cached credentials", [&](std::string const& username, std::string const& password) {
+        BotSrp6::Proof proof;
+        BotCredentialCache::Credentials const& credentials = cached[username];
+        return BotSrp6::ComputeProof(username, challenge, credentials.m_x, credentials.m_hasVerifier ? &credentials.m_verifier : nullptr, getRandomBytes<19>(), proof);
+    });
+
+    // both paths have to agree for the same secret, also where the fixed-width one
+    // reduces B >= N or drops the high zero bytes of A and B before hashing
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        ServerAuthChallenge check = challenge;
+        for (uint8_t& byte : check.m_salt)
+        {
+            byte = uint8_t(random());
+        }
+        for (uint8_t& byte : check.m_B)
+        {
+            byte = uint8_t(random());
+        }
+        switch (i % 4)
+        {
+            case 0: check.m_B[31] = 0xFF; break; // above N
+            case 1: check.m_B[31] = 0x00; break;
+            default: check.m_B[31] = 0x40; break;
+        }
+
+        std::string username = "BENCH" + std::to_string(i);
+        std::array<uint8_t, 20> x = BotSrp6::ComputeX(username, "PASSWORD", check.m_salt);
+        BotUInt256 verifier;
+        bool hasVerifier = i % 2 == 1 && BotSrp6::ComputeVerifier(check, x, verifier);
+        std::array<uint8_t, 19> a;
+        BotSrp6::Proof fast;
+        bool computed = false;
+        // every fourth secret is searched for until A is shorter than N
+        for (uint32_t attempt = 0; attempt < 4096; ++attempt)
+        {
+            for (uint8_t& byte : a)
             {
-                realm->m_port = 8085;
-                realm->m_address = tokens;
+                byte = uint8_t(random());
             }
-            else
+            computed = BotSrp6::ComputeProof(username, check, x, hasVerifier ? &verifier : nullptr, a, fast);
+            if (!computed || i % 4 != 3 || fast.m_aSize < 32)
             {
-                realm->m_address = tokens.substr(0, off);
-                realm->m_port = std::stoi(tokens.substr(off + 1));
+                break;
             }
-            return socket->ReadPOD<float>();
-        })
-        .then([=](float population) { realm->m_population = population; return socket->ReadPOD<uint8_t>(); })
-        .then([=](uint8_t load) { realm->m_load = load; return socket->ReadPOD<uint8_t>(); })
-        .then([=](uint8_t timezone) { realm->m_timezone = timezone; return socket->ReadPOD<uint8_t>(); })
-        .then([=](uint8_t id) {
-            realm->m_id = id;
-            if (realm->m_flags & 4)
+        }
+
+        LogonProof generic = ComputeLogonProofGeneric(username, "PASSWORD", check, a);
+        if (!computed || generic.m_m2Hash != fast.m_m2Hash || generic.m_keyData != fast.m_keyData)
+        {
+            ++mismatches;
+        }
+    }
+    if (mismatches > 0)
+    {
+        BOT_LOG_ERROR("srpbench", "Fixed-width proof does not match the BigNumber one for %u of 16 challenges", mismatches);
+    }
+}
+
+static bool SelectFirstRealm(std::vector<RealmInfo> const& realms, RealmInfo& realm)
+{
+    if (realms.size() == 0)
+    {
+        BOT_LOG_ERROR("Auth", "Authserver did not send any realms");
+        return false;
+    }
+    realm = realms[0];
+    return true;
+}
+
+static WorldPacket BuildAuthSession(std::string const& username, RealmInfo const& realm, WorldPacket& worldAuthChallenge, std::array<uint8_t, 40> const& keyData)
+{
+    uint32_t one = worldAuthChallenge.Read<uint32_t>();
+    uint32_t seed = worldAuthChallenge.Read<uint32_t>();
+    BigNumber seed1 = CreateBigNumber(worldAuthChallenge.ReadBytes(16));
+    BigNumber seed2 = CreateBigNumber(worldAuthChallenge.ReadBytes(16));
+    BigNumber ourSeed = getRandomBytes<4>();
+    WorldPacket authSession = WorldPacket(Opcodes::CMSG_AUTH_SESSION);
+    authSession
+        .Write<uint32_t>(12340)
+        .Write<uint32_t>(0)
+        .WriteCString(username)
+        .Write<uint32_t>(0)
+        .Write<uint32_t>(ourSeed.AsDword())
+        .Write<uint32_t>(0)
+        .Write<uint32_t>(0)
+        .Write<uint32_t>(realm.m_id)
+        .Write<uint64_t>(0)
+        .WriteBytes(SHA1(username, uint32_t(0), ourSeed.AsDword(), uint32_t(seed), keyData))
+        .Write<uint32_t>(0)
+        ;
+    return authSession;
+}
+
+// Runs once the world connection is up, returns false if the login was cancelled
+bool Bot::CloseAuthConnection()
+{
+    bool shouldClose = true;
+    bool cancel = false;
+    FIRE(OnCloseAuthConnection, GetEvents(), {}, *this, BotMutable<bool>(&shouldClose), BotMutable<bool>(&cancel));
+    if (cancel)
+    {
+        m_loginCancelled = true;
+        return false;
+    }
+    if (shouldClose && m_authSocket.has_value())
+    {
+        m_authSocket->Close();
+        m_authSocket.reset();
+    }
+    return true;
+}
+
+static bool IsWorldAuthOk(WorldPacket& packet)
+{
+    if (packet.GetOpcode() != Opcodes::SMSG_AUTH_RESPONSE)
+    {
+        return false;
+    }
+    WorldAuthResponse resp = packet.Read<WorldAuthResponse>();
+    return resp.m_detail == CommandDetail::AUTH_OK;
+}
+
+#ifdef BOTS_AUTH_COROUTINES
+static boost::asio::awaitable<void> AssertAuthCommandAsync(AuthCommand expected, BotSocket& socket)
+{
+    AuthCommand command = co_await socket.ReadPODAsync<AuthCommand>();
+    if (command != expected)
+    {
+        BOT_LOG_ERROR("Auth", "Invalid auth command, expected %s but got %s", AuthCommandString(expected).c_str(), AuthCommandString(command).c_str());
+        throw std::runtime_error("Invalid auth command");
+    }
+
+    if (command == AuthCommand::LOGON_CHALLENGE)
+    {
+        co_await socket.ReadPODAsync<uint8_t>();
+    }
+
+    if (co_await socket.ReadPODAsync<AuthResult>() != AuthResult::SUCCESS)
+    {
+        throw std::runtime_error("Auth command failed");
+    }
+}
+
+// Frames the next world packet, the result views the receive buffer until the next read
+static boost::asio::awaitable<void> ReadWorldPacketAsync(Bot& bot, BotSocket& socket, std::optional<WorldPacket>& packet)
+{
+    packet.reset();
+    while (!WorldPacket::FrameWorldPacket(bot, packet))
+    {
+        co_await socket.ReadSomeAsync();
+    }
+}
+
+boost::asio::awaitable<void> Bot::ConnectAuthServerAsync()
+{
+    m_authSocket.emplace(m_thread->m_context);
+    ApplyImpairment(m_authSocket.value());
+    if (m_thread->m_warmPool.Take(m_authserverIp, GetSourceHint(), m_authSocket.value()))
+    {
+        ArmTimeout(BotTimeoutPhase::HANDSHAKE);
+        co_return;
+    }
+    ArmTimeout(BotTimeoutPhase::CONNECT);
+    co_await m_authSocket->ConnectAsync(m_authserverIp, "3724", GetSourceHint());
+    ArmTimeout(BotTimeoutPhase::HANDSHAKE);
+}
+
+boost::asio::awaitable<bool> Bot::LogonAuthServerAsync()
+{
+    std::weak_ptr<bool> attempt = m_loginAttempt;
+    BuildLogonChallenge(GetUsername(), m_authSocket->m_socket.local_endpoint().address().to_v4().to_uint()).Send(*this);
+    co_await AssertAuthCommandAsync(AuthCommand::LOGON_CHALLENGE, m_authSocket.value());
+
+    ServerAuthChallenge serverChallenge = co_await m_authSocket->ReadPODAsync<ServerAuthChallenge>();
+    // throws if the bot disconnected while the proof was computed
+    LogonProof proof = co_await sBotCryptoPool->RunAsync(attempt, [username = GetUsername(), password = GetPassword(), serverChallenge]() {
+        return ComputeLogonProof(username, password, serverChallenge);
+    });
+    bool cancelLogonProof = false;
+    FIRE(OnAuthProof, GetEvents(), {}, *this, serverChallenge, proof.m_packet, BotMutable<bool>(&cancelLogonProof));
+    if (cancelLogonProof)
+    {
+        m_loginCancelled = true;
+        co_return false;
+    }
+    m_m2Hash = proof.m_m2Hash;
+    m_keyData = proof.m_keyData;
+    proof.m_packet.Send(*this);
+    co_await AssertAuthCommandAsync(AuthCommand::LOGON_PROOF, m_authSocket.value());
+
+    ServerAuthProof serverProof = co_await m_authSocket->ReadPODAsync<ServerAuthProof>();
+    if (serverProof.M2 != m_m2Hash)
+    {
+        BOT_LOG_ERROR("Auth", "Server proof mismatch");
+        throw std::runtime_error("Server proof mismatch");
+    }
+    m_hasSessionKey = true;
+    co_return true;
+}
+
+boost::asio::awaitable<void> Bot::ReconnectAuthServerAsync()
+{
+    BuildLogonChallenge(GetUsername(), m_authSocket->m_socket.local_endpoint().address().to_v4().to_uint(), AuthCommand::RECONNECT_CHALLENGE).Send(*this);
+    co_await AssertAuthCommandAsync(AuthCommand::RECONNECT_CHALLENGE, m_authSocket.value());
+    ServerReconnectChallenge challenge = co_await m_authSocket->ReadPODAsync<ServerReconnectChallenge>();
+    BuildReconnectProof(GetUsername(), challenge, m_keyData).Send(*this);
+    co_await AssertAuthCommandAsync(AuthCommand::RECONNECT_PROOF, m_authSocket.value());
+    co_await m_authSocket->ReadPODAsync<uint16_t>();
+}
+
+boost::asio::awaitable<void> Bot::AuthenticateCoroutine()
+{
+    std::weak_ptr<bool> attempt = m_loginAttempt;
+    try
+    {
+        co_await ConnectAuthServerAsync();
+        bool reconnected = false;
+        if (m_hasSessionKey && m_thread->m_authReconnect)
+        {
+            try
             {
-                return socket->ReadPOD<uint8_t>()
-                    .then([=](uint8_t major) { realm->m_major_version = major; return socket->ReadPOD<uint8_t>(); })
-                    .then([=](uint8_t minor) { realm->m_minor_version = minor; return socket->ReadPOD<uint8_t>(); })
-                    .then([=](uint8_t bugfix) { realm->m_bugfix_version = bugfix; return socket->ReadPOD<uint8_t>(); })
-                    .then([=](uint8_t build) {
-                        realm->m_build = build;
-                        RealmInfo realmVal = *realm;
-                        delete realm;
-                        return promise::resolve(realmVal);
-                    });
+                co_await ReconnectAuthServerAsync();
+                reconnected = true;
             }
-            else
+            catch (boost::system::system_error const& e)
             {
-                RealmInfo realmVal = *realm;
-                delete realm;
-                return promise::resolve(realmVal);
+                if (e.code() == boost::asio::error::operation_aborted || attempt.expired())
+                {
+                    throw;
+                }
             }
-        })
-        .fail([=]() {
-            delete realm;
-        })
-    ;
+            catch (std::exception const&)
+            {
+                if (attempt.expired())
+                {
+                    throw;
+                }
+            }
+
+            if (!reconnected)
+            {
+                // the authserver closes the connection after a failed reconnect
+                BOT_LOG_DEBUG("Auth", "%s could not reconnect, logging in", GetUsername().c_str());
+                m_hasSessionKey = false;
+                co_await ConnectAuthServerAsync();
+            }
+        }
+        if (!reconnected && !co_await LogonAuthServerAsync())
+        {
+            // gives the ramp slot back and drops the handshake timeout, nothing is retried
+            OnLoginFailed();
+            co_return;
+        }
+        AuthPacket(MergeVec(ClientRequestRealmlist({}))).Send(*this);
+
+        ServerRealmlistHeader header = co_await m_authSocket->ReadPODAsync<ServerRealmlistHeader>();
+        size_t bodySize = RealmlistBodySize(header);
+        co_await m_authSocket->FillAsync(bodySize);
+        std::vector<RealmInfo> realms;
+        bool parsed = ParseRealmList(m_authSocket->GetReadBuffer().GetReadPointer(), bodySize, header.count, realms);
+        m_authSocket->GetReadBuffer().ReadCompleted(bodySize);
+        if (!parsed || !SelectFirstRealm(realms, m_realm))
+        {
+            throw std::runtime_error("No realm to connect to");
+        }
+        FIRE(OnSelectRealm, GetEvents(), {}, *this, realms, BotMutable<RealmInfo>(&this->m_realm));
+
+        ArmTimeout(BotTimeoutPhase::CONNECT);
+        m_worldSocket.emplace(m_thread->m_context);
+        ApplyImpairment(m_worldSocket.value());
+        co_await m_worldSocket->ConnectAsync(m_realm.m_address, std::to_string(m_realm.m_port), GetSourceHint());
+        ArmTimeout(BotTimeoutPhase::HANDSHAKE);
+        if (!CloseAuthConnection())
+        {
+            OnLoginFailed();
+            co_return;
+        }
+        std::optional<WorldPacket> packet;
+        co_await ReadWorldPacketAsync(*this, m_worldSocket.value(), packet);
+        if (packet->GetOpcode() != Opcodes::SMSG_AUTH_CHALLENGE)
+        {
+            throw std::runtime_error("Expected SMSG_AUTH_CHALLENGE");
+        }
+        BuildAuthSession(GetUsername(), m_realm, packet.value(), m_keyData).Send(*this);
+        SetEncryptionKey(m_keyData);
+
+        co_await ReadWorldPacketAsync(*this, m_worldSocket.value(), packet);
+        if (!IsWorldAuthOk(packet.value()))
+        {
+            throw std::runtime_error("World authentication failed");
+        }
+        packet.reset();
+        ConnectionLoop();
+        m_isLoggedIn = true;
+        co_return;
+    }
+    catch (boost::system::system_error const& e)
+    {
+        // the bot (and its sockets) may already be gone
+        if (e.code() == boost::asio::error::operation_aborted || attempt.expired())
+        {
+            co_return;
+        }
+        BOT_LOG_DEBUG("Auth", "%s failed to log in: %s", GetUsername().c_str(), e.what());
+    }
+    catch (std::exception const& e)
+    {
+        if (attempt.expired())
+        {
+            co_return;
+        }
+        BOT_LOG_DEBUG("Auth", "%s failed to log in: %s", GetUsername().c_str(), e.what());
+    }
+    OnLoginFailed();
 }
+#endif
 
-void Bot::Authenticate()
+promise::Promise Bot::ConnectAuthServer()
 {
-    BOT_LOG_DEBUG("Auth", "%s authenticating to %s", GetUsername().c_str(), m_authserverIp.c_str());
-    m_authSocket.emplace(BotSocket(m_thread->m_context));
-    m_authSocket->Connect(m_authserverIp,"3724")
-    .then([this]() {
-        AuthPacket pkt(MergeVec(ClientAuthChallenge(GetUsername(), m_authSocket->m_socket.local_endpoint().address().to_v4().to_uint()), GetUsername()));
-        return pkt.Send(*this);
-    })
+    m_authSocket.emplace(m_thread->m_context);
+    ApplyImpairment(m_authSocket.value());
+    if (m_thread->m_warmPool.Take(m_authserverIp, GetSourceHint(), m_authSocket.value()))
+    {
+        ArmTimeout(BotTimeoutPhase::HANDSHAKE);
+        return promise::resolve();
+    }
+    ArmTimeout(BotTimeoutPhase::CONNECT);
+    return m_authSocket->Connect(m_authserverIp, "3724", GetSourceHint())
+        .then([this]() { ArmTimeout(BotTimeoutPhase::HANDSHAKE); });
+}
+
+promise::Promise Bot::LogonAuthServer()
+{
+    std::weak_ptr<bool> attempt = m_loginAttempt;
+    return BuildLogonChallenge(GetUsername(), m_authSocket->m_socket.local_endpoint().address().to_v4().to_uint()).Send(*this)
     .then([this]() {
         return AssertAuthCommand(AuthCommand::LOGON_CHALLENGE, &m_authSocket.value());
     })
     .then([this]() {
         return m_authSocket->ReadPOD<ServerAuthChallenge>();
     })
-    .then([this](ServerAuthChallenge serverChallenge) {
-        std::string authString = GetUsername() + ":" + GetPassword();
-        std::transform(authString.begin(), authString.end(), authString.begin(), [](uint8_t c) {return std::toupper(c); });
-        // this is just a bunch of math
-        BigNumber k(3);
-        BigNumber B = CreateBigNumber<32>(serverChallenge.m_B);
-        BigNumber g(serverChallenge.m_g);
-        BigNumber N = CreateBigNumber<32>(serverChallenge.m_N);
-        BigNumber salt = CreateBigNumber<32>(serverChallenge.m_salt);
-        BigNumber unk1 = CreateBigNumber<16>(serverChallenge.m_unk3);
-        BigNumber x = CreateBigNumber(SHA1(serverChallenge.m_salt, SHA1(authString)));
-        BigNumber A;
-        BigNumber a;
-        do
-        {
-            a = BigNumber(getRandomBytes<19>());
-            A = g.ModExp(a, N);
-        } while (A.ModExp(1, N) == 0);
-        BigNumber u = CreateBigNumber(SHA1(A, B));
-        BigNumber S = ((B + k * (N - g.ModExp(x, N))) % N).ModExp(a + (u * x), N);
-        std::vector<uint8_t> sData = MergeVec(S);
-        if (sData.size() < 32)
-            sData.resize(32);
-        std::array<uint8_t, 40> keyData;
-        std::array<uint8_t, 16> temp;
-        for (int i = 0; i < 16; ++i)
-            temp[i] = sData[i * 2];
-        std::array<uint8_t, 20> keyHash = SHA1(temp);
-        for (int i = 0; i < 20; ++i)
-            keyData[int64_t(i) * 2] = keyHash[i];
-        for (int i = 0; i < 16; ++i)
-            temp[i] = sData[int64_t(i) * 2 + 1];
-        keyHash = SHA1(temp);
-        for (int i = 0; i < 20; ++i)
-            keyData[int64_t(i) * 2 + 1] = keyHash[i];
-        BigNumber key(keyData);
-        std::vector<uint8_t> gnHash(20);
-        auto nHash = SHA1(N);
-        for (int i = 0; i < 20; ++i)
-            gnHash[i] = nHash[i];
-        auto gHash = SHA1(g);
-        for (int i = 0; i < 20; ++i)
-            gnHash[i] ^= gHash[i];
-        auto m1Hash = SHA1(gnHash, SHA1(GetUsername()), serverChallenge.m_salt, A, B, key);
-        m_m2Hash = SHA1(A, m1Hash, keyData);
-        auto packet = AuthPacket(MergeVec(uint8_t(AuthCommand::LOGON_PROOF), A, m1Hash, std::vector<uint8_t>(22)));
-        bool cancelLogonProof = false;
-        FIRE(OnAuthProof, GetEvents(), {}, *this, serverChallenge, packet, BotMutable<bool>(&cancelLogonProof));
-        if (cancelLogonProof)
-        {
-            return promise::reject();
-        }
-        m_keyData = keyData;
-        return packet.Send(*this);
+    .then([this, attempt](ServerAuthChallenge serverChallenge) {
+        return sBotCryptoPool->Run(m_thread->m_context, attempt, [username = GetUsername(), password = GetPassword(), serverChallenge]() {
+            return ComputeLogonProof(username, password, serverChallenge);
+        })
+        .then([this, serverChallenge](LogonProof& proof) mutable {
+            bool cancelLogonProof = false;
+            FIRE(OnAuthProof, GetEvents(), {}, *this, serverChallenge, proof.m_packet, BotMutable<bool>(&cancelLogonProof));
+            if (cancelLogonProof)
+            {
+                m_loginCancelled = true;
+                return promise::reject();
+            }
+            m_m2Hash = proof.m_m2Hash;
+            m_keyData = proof.m_keyData;
+            return proof.m_packet.Send(*this);
+        });
     })
     .then([this]() { return AssertAuthCommand(AuthCommand::LOGON_PROOF, &m_authSocket.value()); })
     .then([this]() { return m_authSocket->ReadPOD<ServerAuthProof>(); })
@@ -421,87 +911,119 @@ void Bot::Authenticate()
             BOT_LOG_ERROR("Auth", "Server proof mismatch");
             return promise::reject();
         }
+        m_hasSessionKey = true;
+        return promise::resolve();
+    });
+}
+
+promise::Promise Bot::ReconnectAuthServer()
+{
+    return BuildLogonChallenge(GetUsername(), m_authSocket->m_socket.local_endpoint().address().to_v4().to_uint(), AuthCommand::RECONNECT_CHALLENGE).Send(*this)
+    .then([this]() { return AssertAuthCommand(AuthCommand::RECONNECT_CHALLENGE, &m_authSocket.value()); })
+    .then([this]() { return m_authSocket->ReadPOD<ServerReconnectChallenge>(); })
+    .then([this](ServerReconnectChallenge& challenge) { return BuildReconnectProof(GetUsername(), challenge, m_keyData).Send(*this); })
+    .then([this]() { return AssertAuthCommand(AuthCommand::RECONNECT_PROOF, &m_authSocket.value()); })
+    .then([this]() { return m_authSocket->ReadPOD<uint16_t>(); });
+}
+
+void Bot::Authenticate()
+{
+    BOT_LOG_DEBUG("Auth", "%s authenticating to %s", GetUsername().c_str(), m_authserverIp.c_str());
+#ifdef BOTS_AUTH_COROUTINES
+    boost::asio::co_spawn(m_thread->m_context, AuthenticateCoroutine(), boost::asio::detached);
+#else
+    std::weak_ptr<bool> attempt = m_loginAttempt;
+    ConnectAuthServer()
+    .then([this, attempt]() {
+        if (!m_hasSessionKey || !m_thread->m_authReconnect)
+        {
+            return LogonAuthServer();
+        }
+        return promise::newPromise([this, attempt](promise::Defer& defer) {
+            ReconnectAuthServer()
+                .then([defer]() { defer.resolve(); })
+                .fail([this, attempt, defer]() {
+                    // the authserver closes the connection after a failed reconnect, so start over
+                    // once the old socket's handlers are done with it
+                    boost::asio::post(m_thread->m_context, [this, attempt, defer]() {
+                        if (attempt.expired())
+                        {
+                            return defer.reject();
+                        }
+                        BOT_LOG_DEBUG("Auth", "%s could not reconnect, logging in", GetUsername().c_str());
+                        m_hasSessionKey = false;
+                        ConnectAuthServer()
+                            .then([this]() { return LogonAuthServer(); })
+                            .then([defer]() { defer.resolve(); })
+                            .fail([defer]() { defer.reject(); });
+                    });
+                });
+        });
+    })
+    .then([this]() {
         AuthPacket realmlistRequest(MergeVec(ClientRequestRealmlist({})));
         return realmlistRequest.Send(*this);
     })
     .then([this]() { return m_authSocket->ReadPOD<ServerRealmlistHeader>(); })
     .then([this](ServerRealmlistHeader header) {
-        std::vector<RealmInfo>* realms = new std::vector<RealmInfo>();
-        realms->reserve(header.size);
-        uint16_t* count = new uint16_t(header.size);
-        return promise::doWhile([=](promise::DeferLoop& loop) {
-            if (*count == 0)
+        size_t bodySize = RealmlistBodySize(header);
+        return m_authSocket->Fill(bodySize).then([=]() {
+            std::vector<RealmInfo> realms;
+            bool parsed = ParseRealmList(m_authSocket->GetReadBuffer().GetReadPointer(), bodySize, header.count, realms);
+            m_authSocket->GetReadBuffer().ReadCompleted(bodySize);
+            if (!parsed)
             {
-                std::vector<RealmInfo> realmsCpy;
-                realmsCpy.insert(realmsCpy.end(), realms->begin(), realms->end());
-                delete realms;
-                delete count;
-                return loop.doBreak(realmsCpy);
+                return promise::reject();
             }
-            ReadRealmInfo(&m_authSocket.value())
-                .then([=](RealmInfo info){
-                    realms->push_back(info);
-                    (*count)--;
-                    loop.doContinue();
-                })
-                .fail([=](){
-                    delete realms;
-                    delete count;
-                });
+            return promise::resolve(realms);
         });
     })
     .then([this](std::vector<RealmInfo> realms) {
-        m_realm = realms[0];
+        if (!SelectFirstRealm(realms, m_realm))
+        {
+            return promise::reject();
+        }
         FIRE(OnSelectRealm, GetEvents(), {}, *this, realms, BotMutable<RealmInfo>(&this->m_realm));
-        m_worldSocket.emplace(BotSocket(m_thread->m_context));
-        return m_worldSocket->Connect(m_realm.m_address, std::to_string(m_realm.m_port));
+        ArmTimeout(BotTimeoutPhase::CONNECT);
+        m_worldSocket.emplace(m_thread->m_context);
+        ApplyImpairment(m_worldSocket.value());
+        return m_worldSocket->Connect(m_realm.m_address, std::to_string(m_realm.m_port), GetSourceHint());
+    })
+    .then([this]() {
+        ArmTimeout(BotTimeoutPhase::HANDSHAKE);
+        if (!CloseAuthConnection())
+        {
+            return promise::reject();
+        }
+        return WorldPacket::ReadWorldPacket(this);
     })
-    .then([this]() { return WorldPacket::ReadWorldPacket(this); })
     .then([this](WorldPacket worldAuthChallenge) {
         if (worldAuthChallenge.GetOpcode() != Opcodes::SMSG_AUTH_CHALLENGE)
         {
             return promise::reject();
         }
-        uint32_t one = worldAuthChallenge.Read<uint32_t>();
-        uint32_t seed = worldAuthChallenge.Read<uint32_t>();
-        BigNumber seed1 = CreateBigNumber(worldAuthChallenge.ReadBytes(16));
-        BigNumber seed2 = CreateBigNumber(worldAuthChallenge.ReadBytes(16));
-        BigNumber ourSeed = getRandomBytes<4>();
-        WorldPacket authSession = WorldPacket(Opcodes::CMSG_AUTH_SESSION);
-        authSession
-            .Write<uint32_t>(12340)
-            .Write<uint32_t>(0)
-            .WriteCString(GetUsername())
-            .Write<uint32_t>(0)
-            .Write<uint32_t>(ourSeed.AsDword())
-            .Write<uint32_t>(0)
-            .Write<uint32_t>(0)
-            .Write<uint32_t>(m_realm.m_id)
-            .Write<uint64_t>(0)
-            .WriteBytes(SHA1(GetUsername(), uint32_t(0), ourSeed.AsDword(), uint32_t(seed), m_keyData))
-            .Write<uint32_t>(0)
-            ;
-        return authSession.Send(*this);
+        return BuildAuthSession(GetUsername(), m_realm, worldAuthChallenge, m_keyData).Send(*this);
     })
     .then([this](){
         SetEncryptionKey(m_keyData);
         return WorldPacket::ReadWorldPacket(this);
     })
     .then([this](WorldPacket packet){
-        if (packet.GetOpcode() != Opcodes::SMSG_AUTH_RESPONSE)
-        {
-            return promise::reject();
-        }
-        WorldAuthResponse resp = packet.Read<WorldAuthResponse>();
-        if (resp.m_detail != CommandDetail::AUTH_OK)
+        if (!IsWorldAuthOk(packet))
         {
             return promise::reject();
-            //throw std::runtime_error(std::string("World authentication failed: ") + std::to_string(uint32_t(resp.m_detail)));
         }
         ConnectionLoop();
         m_isLoggedIn = true;
         return promise::resolve();
     })
-    .fail([this](){})
+    .fail([this, attempt]() {
+        // failures caused by DisconnectNow are not retried, the bot may be gone
+        if (!attempt.expired())
+        {
+            OnLoginFailed();
+        }
+    })
     ;
+#endif
 }
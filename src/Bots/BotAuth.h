@@ -116,3 +116,6 @@ struct WorldAuthResponse
     uint8_t expansion;
 };
 #pragma pack(pop)
+
+// Times login proofs with BigNumber and with BotSrp6 on the calling thread
+void RunSrp6Benchmark(uint32_t count);
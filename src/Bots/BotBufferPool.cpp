@@ -0,0 +1,117 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotBufferPool.h"
+
+static thread_local BotBufferPool* currentPool = nullptr;
+
+// 64, 256, 1024, 4096, 16384, 65536
+size_t BotBufferPool::GetClassSize(size_t sizeClass)
+{
+    return MIN_CLASS_SIZE << (sizeClass * 2);
+}
+
+std::vector<uint8_t> BotBufferPool::Acquire(size_t capacity)
+{
+    for (size_t i = 0; i < CLASS_COUNT; ++i)
+    {
+        if (GetClassSize(i) < capacity)
+        {
+            continue;
+        }
+
+        std::vector<uint8_t> buffer;
+        if (m_free[i].size() > 0)
+        {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            buffer = std::move(m_free[i].back());
+            m_free[i].pop_back();
+        }
+        else
+        {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            buffer.reserve(GetClassSize(i));
+        }
+        return buffer;
+    }
+
+    // too big to pool
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    std::vector<uint8_t> buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void BotBufferPool::Release(std::vector<uint8_t>&& buffer)
+{
+    // buffers that grew past the largest class would stay cached at their full size
+    if (buffer.capacity() > GetClassSize(CLASS_COUNT - 1))
+    {
+        return;
+    }
+    // file under the largest class the buffer can serve
+    for (size_t i = CLASS_COUNT; i > 0; --i)
+    {
+        if (buffer.capacity() >= GetClassSize(i - 1))
+        {
+            if (m_free[i - 1].size() < MAX_CACHED_PER_CLASS)
+            {
+                buffer.clear();
+                m_free[i - 1].push_back(std::move(buffer));
+            }
+            return;
+        }
+    }
+}
+
+uint64_t BotBufferPool::GetHits() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+uint64_t BotBufferPool::GetMisses() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+BotBufferPool* BotBufferPool::GetCurrent()
+{
+    return currentPool;
+}
+
+void BotBufferPool::SetCurrent(BotBufferPool* pool)
+{
+    currentPool = pool;
+}
+
+std::vector<uint8_t> BotBufferPool::AcquireBuffer(size_t capacity)
+{
+    if (currentPool)
+    {
+        return currentPool->Acquire(capacity);
+    }
+    std::vector<uint8_t> buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void BotBufferPool::ReleaseBuffer(std::vector<uint8_t>&& buffer)
+{
+    if (currentPool && buffer.capacity() > 0)
+    {
+        currentPool->Release(std::move(buffer));
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Size-classed free lists of packet buffers. Every BotThread owns one and
+// installs it as the current pool of its OS thread, so packets can grab and
+// return storage without locking. Threads without a pool (e.g. the console)
+// fall back to plain allocations.
+class BotBufferPool
+{
+public:
+    // Returns an empty buffer with at least "capacity" bytes reserved
+    std::vector<uint8_t> Acquire(size_t capacity);
+    // Keeps the buffer for a later Acquire, frees it if it is larger than the largest class
+    void Release(std::vector<uint8_t>&& buffer);
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+    static BotBufferPool* GetCurrent();
+    static void SetCurrent(BotBufferPool* pool);
+    // Acquire/Release on the current threads pool, if it has one
+    static std::vector<uint8_t> AcquireBuffer(size_t capacity);
+    static void ReleaseBuffer(std::vector<uint8_t>&& buffer);
+private:
+    static constexpr size_t CLASS_COUNT = 6;
+    static constexpr size_t MIN_CLASS_SIZE = 64;
+    static constexpr size_t MAX_CACHED_PER_CLASS = 256;
+    static size_t GetClassSize(size_t sizeClass);
+    std::array<std::vector<std::vector<uint8_t>>, CLASS_COUNT> m_free;
+    // read by the console thread
+    std::atomic<uint64_t> m_hits = 0;
+    std::atomic<uint64_t> m_misses = 0;
+};
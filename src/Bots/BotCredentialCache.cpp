@@ -0,0 +1,196 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotCredentialCache.h"
+#include "BotAuth.h"
+#include "BotProfile.h"
+#include "BotAccounts.h"
+#include "BotCrypto.h"
+#include "BotLogging.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <unordered_map>
+
+template <size_t N>
+static std::string ToHex(std::array<uint8_t, N> const& bytes)
+{
+    std::string hex(N * 2, '0');
+    for (size_t i = 0; i < N; ++i)
+    {
+        snprintf(&hex[i * 2], 3, "%02x", bytes[i]);
+    }
+    return hex;
+}
+
+template <size_t N>
+static bool FromHex(std::string const& hex, std::array<uint8_t, N>& bytes)
+{
+    if (hex.size() != N * 2)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < N; ++i)
+    {
+        unsigned int byte;
+        if (sscanf(hex.c_str() + i * 2, "%2x", &byte) != 1)
+        {
+            return false;
+        }
+        bytes[i] = uint8_t(byte);
+    }
+    return true;
+}
+
+static std::string ToUpper(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), [](uint8_t c) { return std::toupper(c); });
+    return value;
+}
+
+BotCredentialCache* BotCredentialCache::instance()
+{
+    static BotCredentialCache cache;
+    return &cache;
+}
+
+void BotCredentialCache::Load()
+{
+    std::vector<Key> keys;
+    {
+        std::scoped_lock lock(m_mutex);
+        m_enabled = sConfigMgr->GetBoolDefault("Bots.CredentialCache", true);
+        m_entries.clear();
+        m_stored.clear();
+        m_file.close();
+        std::string path = sConfigMgr->GetStringDefault("Bots.CredentialCacheFile", "");
+        if (!m_enabled || path.empty())
+        {
+            return;
+        }
+
+        // one "username salt N g" line per account and server
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            std::string salt;
+            std::string n;
+            unsigned int g = 0;
+            Key key;
+            if (!(stream >> key.m_username >> salt >> n >> g) || !FromHex(salt, key.m_salt) || !FromHex(n, key.m_N) || g > 0xFF)
+            {
+                BOT_LOG_WARN("crypto", "Skipping invalid line in %s: %s", path.c_str(), line.c_str());
+                continue;
+            }
+            key.m_g = uint8_t(g);
+            if (m_stored.insert(key).second)
+            {
+                keys.push_back(key);
+            }
+        }
+        m_file.open(path, std::ios::app);
+        if (!m_file.is_open())
+        {
+            BOT_LOG_ERROR("crypto", "Could not open %s for writing", path.c_str());
+        }
+    }
+    Precompute(keys);
+}
+
+void BotCredentialCache::Precompute(std::vector<Key> const& keys)
+{
+    std::unordered_map<std::string, std::string> passwords;
+    for (BotAccount& account : GetAllBotAccounts())
+    {
+        passwords[ToUpper(account.GetUsername())] = account.GetPassword();
+    }
+
+    std::vector<std::pair<Key const*, Entry>> jobs;
+    for (Key const& key : keys)
+    {
+        auto itr = passwords.find(key.m_username);
+        if (itr != passwords.end())
+        {
+            jobs.push_back({ &key, Entry{ itr->second, {} } });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sBotCryptoPool->ParallelFor(jobs.size(), [&](size_t i) {
+        jobs[i].second.m_credentials = Compute(jobs[i].second.m_password, *jobs[i].first);
+    });
+
+    std::scoped_lock lock(m_mutex);
+    for (auto& [key, entry] : jobs)
+    {
+        m_entries[*key] = std::move(entry);
+    }
+    BOT_LOG_INFO("crypto", "Precomputed login credentials for %u accounts in %.3fs"
+        , uint32_t(jobs.size())
+        , std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+    );
+}
+
+BotCredentialCache::Credentials BotCredentialCache::Compute(std::string const& password, Key const& key)
+{
+    ServerAuthChallenge challenge = {};
+    challenge.m_salt = key.m_salt;
+    challenge.m_N = key.m_N;
+    challenge.m_g = key.m_g;
+    Credentials credentials;
+    credentials.m_x = BotSrp6::ComputeX(key.m_username, password, key.m_salt);
+    credentials.m_hasVerifier = BotSrp6::ComputeVerifier(challenge, credentials.m_x, credentials.m_verifier);
+    return credentials;
+}
+
+void BotCredentialCache::Clear()
+{
+    std::scoped_lock lock(m_mutex);
+    m_entries.clear();
+}
+
+BotCredentialCache::Credentials BotCredentialCache::Get(std::string const& username, std::string const& password, ServerAuthChallenge const& challenge)
+{
+    Key key{ ToUpper(username), challenge.m_salt, challenge.m_N, challenge.m_g };
+    if (!m_enabled)
+    {
+        return Compute(password, key);
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        auto itr = m_entries.find(key);
+        if (itr != m_entries.end() && itr->second.m_password == password)
+        {
+            return itr->second.m_credentials;
+        }
+    }
+
+    Credentials credentials = Compute(password, key);
+    std::scoped_lock lock(m_mutex);
+    m_entries[key] = { password, credentials };
+    if (m_file.is_open() && m_stored.insert(key).second)
+    {
+        m_file << key.m_username << ' ' << ToHex(key.m_salt) << ' ' << ToHex(key.m_N) << ' ' << uint32_t(key.m_g) << std::endl;
+    }
+    return credentials;
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "BotSrp6.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct ServerAuthChallenge;
+
+// Per-account SRP6 values that only change with the password or the server's salt, N and g,
+// so re-logins skip the hashing and the verifier exponentiation.
+// With Bots.CredentialCacheFile set, the salts (never the derived values) are written to disk
+// and the cache is filled from accounts.json in parallel at startup.
+class BotCredentialCache
+{
+public:
+    struct Credentials
+    {
+        std::array<uint8_t, 20> m_x;
+        // g^x mod N, unset if BotSrp6 can not use N
+        bool m_hasVerifier = false;
+        BotUInt256 m_verifier;
+    };
+    static BotCredentialCache* instance();
+    void Load();
+    // Thread-safe, computes and stores the values on a miss
+    Credentials Get(std::string const& username, std::string const& password, ServerAuthChallenge const& challenge);
+    // Forgets the computed values, the salts in the cache file stay
+    void Clear();
+private:
+    struct Key
+    {
+        std::string m_username;
+        std::array<uint8_t, 32> m_salt;
+        std::array<uint8_t, 32> m_N;
+        uint8_t m_g;
+        bool operator<(Key const& other) const
+        {
+            return std::tie(m_username, m_salt, m_N, m_g) < std::tie(other.m_username, other.m_salt, other.m_N, other.m_g);
+        }
+    };
+    struct Entry
+    {
+        // a changed password misses even with the same salt
+        std::string m_password;
+        Credentials m_credentials;
+    };
+    static Credentials Compute(std::string const& password, Key const& key);
+    void Precompute(std::vector<Key> const& keys);
+    std::mutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    // keys already in the cache file
+    std::set<Key> m_stored;
+    bool m_enabled = true;
+    std::ofstream m_file;
+};
+
+#define sBotCredentialCache BotCredentialCache::instance()
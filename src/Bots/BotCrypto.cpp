@@ -0,0 +1,104 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotCrypto.h"
+#include "BotLogging.h"
+#include "Config.h"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+struct BotCryptoPool::Workers
+{
+    Workers(uint32_t count)
+        : m_pool(count)
+        , m_count(count)
+    {}
+    thread_pool m_pool;
+    uint32_t m_count;
+};
+
+BotCryptoPool* BotCryptoPool::instance()
+{
+    static BotCryptoPool pool;
+    return &pool;
+}
+
+void BotCryptoPool::Load()
+{
+    uint32_t count = std::max(sConfigMgr->GetIntDefault("Bots.CryptoThreadCount", 2), 0);
+    m_workers.reset();
+    if (count > 0)
+    {
+        m_workers = std::make_unique<Workers>(count);
+    }
+    BOT_LOG_DEBUG("crypto", "Using %u crypto threads", count);
+}
+
+bool BotCryptoPool::HasWorkers() const
+{
+    return m_workers != nullptr;
+}
+
+void BotCryptoPool::Stop()
+{
+    if (m_workers)
+    {
+        m_workers->m_pool.wait_for_tasks();
+        m_workers.reset();
+    }
+}
+
+void BotCryptoPool::Submit(std::function<void()> task)
+{
+    m_workers->m_pool.push_task(std::move(task));
+}
+
+void BotCryptoPool::ParallelFor(size_t count, std::function<void(size_t)> const& work)
+{
+    if (!HasWorkers())
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            work(i);
+        }
+        return;
+    }
+
+    size_t chunks = std::min<size_t>(count, m_workers->m_count);
+    size_t remaining = chunks;
+    std::mutex mutex;
+    std::condition_variable done;
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        Submit([&, chunk]() {
+            for (size_t i = chunk; i < count; i += chunks)
+            {
+                work(i);
+            }
+            std::scoped_lock lock(mutex);
+            if (--remaining == 0)
+            {
+                done.notify_one();
+            }
+        });
+    }
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&]() { return remaining == 0; });
+}
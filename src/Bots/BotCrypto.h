@@ -0,0 +1,120 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <promise.hpp>
+
+#ifdef BOTS_AUTH_COROUTINES
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// Worker threads for the handshake math (SRP6), so a login storm does not stall
+// packet handling on the BotThreads. Results are handed back to the submitting
+// thread's io_context. Without workers (Bots.CryptoThreadCount = 0) work runs inline.
+class BotCryptoPool
+{
+public:
+    static BotCryptoPool* instance();
+    void Load();
+    bool HasWorkers() const;
+
+    // Resolves with work()'s result on "context", or rejects there if "lifetime" expired meanwhile.
+    // Work whose lifetime expired before a worker got to it is skipped.
+    template <typename F>
+    promise::Promise Run(boost::asio::io_context& context, std::weak_ptr<bool> lifetime, F work)
+    {
+        using Result = decltype(work());
+        return promise::newPromise([&](promise::Defer& defer) {
+            if (!HasWorkers())
+            {
+                return defer.resolve(work());
+            }
+            // defers are not thread safe (PROMISE_MULTITHREAD=0), so the worker only passes this
+            // pointer on and the defer is used on "context". If that stopped, the handler frees it.
+            // "context" outlives the job because BotMgr stops the pool before its threads go.
+            std::shared_ptr<promise::Defer> owned = std::make_shared<promise::Defer>(defer);
+            Submit([&context, lifetime, owned, work]() mutable {
+                std::shared_ptr<std::optional<Result>> result = std::make_shared<std::optional<Result>>();
+                if (!lifetime.expired())
+                {
+                    result->emplace(work());
+                }
+                boost::asio::post(context, [lifetime, owned = std::move(owned), result]() {
+                    if (lifetime.expired() || !result->has_value())
+                    {
+                        return owned->reject();
+                    }
+                    owned->resolve(result->value());
+                });
+            });
+        });
+    }
+
+#ifdef BOTS_AUTH_COROUTINES
+    // Awaitable version of Run, the coroutine resumes on its own executor. Throws
+    // operation_aborted if "lifetime" expired meanwhile.
+    template <typename F>
+    boost::asio::awaitable<decltype(std::declval<F>()())> RunAsync(std::weak_ptr<bool> lifetime, F work)
+    {
+        using Result = decltype(work());
+        if (!HasWorkers())
+        {
+            co_return work();
+        }
+        auto executor = co_await boost::asio::this_coro::executor;
+        // shared with the job, the coroutine frame can be gone before it finishes
+        std::shared_ptr<std::optional<Result>> result = std::make_shared<std::optional<Result>>();
+        co_await boost::asio::async_initiate<decltype(boost::asio::use_awaitable), void()>([&](auto handler) {
+            auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+            Submit([result, lifetime, work, executor, shared]() {
+                if (!lifetime.expired())
+                {
+                    result->emplace(work());
+                }
+                boost::asio::post(executor, [shared]() { std::move(*shared)(); });
+            });
+        }, boost::asio::use_awaitable);
+        if (lifetime.expired() || !result->has_value())
+        {
+            throw boost::system::system_error(boost::asio::error::operation_aborted);
+        }
+        co_return std::move(result->value());
+    }
+#endif
+    // Waits for the queued work and joins the workers, later work runs inline
+    void Stop();
+    // Runs work(0) to work(count - 1) spread over the workers and blocks until all are done
+    void ParallelFor(size_t count, std::function<void(size_t)> const& work);
+private:
+    void Submit(std::function<void()> task);
+    struct Workers;
+    std::unique_ptr<Workers> m_workers;
+};
+
+#define sBotCryptoPool BotCryptoPool::instance()
@@ -0,0 +1,199 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotIoBackend.h"
+#include "BotLogging.h"
+
+#include "Config.h"
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using boost::asio::ip::tcp;
+
+char const* GetIoBackendName()
+{
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "uring";
+#else
+    return "epoll";
+#endif
+}
+
+void CheckIoBackend()
+{
+    std::string backend = sConfigMgr->GetStringDefault("Bots.IoBackend", "epoll");
+    if (backend != "epoll" && backend != "uring")
+    {
+        BOT_LOG_WARN("network", "Unknown Bots.IoBackend \"%s\", using %s", backend.c_str(), GetIoBackendName());
+    }
+    else if (backend != GetIoBackendName())
+    {
+        // asio picks its reactor at compile time (BOTS_IO_URING cmake option)
+        BOT_LOG_WARN("network", "Bots.IoBackend is \"%s\" but this build uses %s, falling back to %s", backend.c_str(), GetIoBackendName(), GetIoBackendName());
+    }
+    BOT_LOG_INFO("network", "Using %s io backend", GetIoBackendName());
+}
+
+namespace
+{
+    struct EchoSession : std::enable_shared_from_this<EchoSession>
+    {
+        EchoSession(tcp::socket&& socket) : m_socket(std::move(socket)), m_buffer(4096) {}
+        void Read()
+        {
+            auto self = shared_from_this();
+            m_socket.async_read_some(boost::asio::buffer(m_buffer), [self](boost::system::error_code const& ec, size_t len) {
+                if (ec.failed())
+                {
+                    return;
+                }
+                boost::asio::async_write(self->m_socket, boost::asio::buffer(self->m_buffer.data(), len), [self](boost::system::error_code const& ec, size_t) {
+                    if (!ec.failed())
+                    {
+                        self->Read();
+                    }
+                });
+            });
+        }
+        tcp::socket m_socket;
+        std::vector<uint8_t> m_buffer;
+    };
+
+    struct PingClient : std::enable_shared_from_this<PingClient>
+    {
+        PingClient(boost::asio::io_context& ctx, uint32_t messages, uint32_t size, uint32_t& finished, uint32_t& failed)
+            : m_socket(ctx), m_out(size, 0x5A), m_in(size), m_remaining(messages), m_finished(finished), m_failed(failed) {}
+        void Start(tcp::endpoint const& endpoint)
+        {
+            auto self = shared_from_this();
+            m_socket.async_connect(endpoint, [self](boost::system::error_code const& ec) {
+                if (ec.failed())
+                {
+                    return self->Done(false);
+                }
+                self->m_socket.set_option(tcp::no_delay(true));
+                self->Ping();
+            });
+        }
+        void Ping()
+        {
+            if (m_remaining-- == 0)
+            {
+                return Done(true);
+            }
+            auto self = shared_from_this();
+            boost::asio::async_write(m_socket, boost::asio::buffer(m_out), [self](boost::system::error_code const& ec, size_t) {
+                if (ec.failed())
+                {
+                    return self->Done(false);
+                }
+                boost::asio::async_read(self->m_socket, boost::asio::buffer(self->m_in), [self](boost::system::error_code const& ec, size_t) {
+                    if (ec.failed())
+                    {
+                        return self->Done(false);
+                    }
+                    self->Ping();
+                });
+            });
+        }
+        void Done(bool success)
+        {
+            ++(success ? m_finished : m_failed);
+            m_socket.close();
+        }
+        tcp::socket m_socket;
+        std::vector<uint8_t> m_out;
+        std::vector<uint8_t> m_in;
+        uint32_t m_remaining;
+        uint32_t& m_finished;
+        uint32_t& m_failed;
+    };
+}
+
+static void RunIoBenchmarkRound(uint32_t connections, uint32_t messages, uint32_t size)
+{
+    boost::asio::io_context ctx;
+    boost::system::error_code ec;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0), true);
+    acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+    if (ec.failed())
+    {
+        BOT_LOG_ERROR("iobench", "Failed to listen: %s", ec.message().c_str());
+        return;
+    }
+
+    std::function<void()> accept = [&]() {
+        acceptor.async_accept([&](boost::system::error_code const& ec, tcp::socket socket) {
+            if (ec == boost::asio::error::operation_aborted)
+            {
+                return;
+            }
+            if (ec.failed())
+            {
+                // usually out of file descriptors, accepted clients would wait forever
+                BOT_LOG_ERROR("iobench", "Failed to accept: %s", ec.message().c_str());
+                return ctx.stop();
+            }
+            socket.set_option(tcp::no_delay(true));
+            std::make_shared<EchoSession>(std::move(socket))->Read();
+            accept();
+        });
+    };
+    accept();
+
+    uint32_t finished = 0;
+    uint32_t failed = 0;
+    tcp::endpoint endpoint = acceptor.local_endpoint();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < connections; ++i)
+    {
+        std::make_shared<PingClient>(ctx, messages, size, finished, failed)->Start(endpoint);
+    }
+
+    while (finished + failed < connections && ctx.run_one() > 0) {}
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    acceptor.close();
+    ctx.stop();
+
+    double roundTrips = double(finished) * messages;
+    BOT_LOG_INFO("iobench", "%s: %u connections (%u failed), %u x %u byte round trips each: %.3fs, %.0f round trips/s"
+        , GetIoBackendName()
+        , connections
+        , failed
+        , messages
+        , size
+        , seconds
+        , seconds > 0 ? roundTrips / seconds : 0.0
+    );
+}
+
+void RunIoBenchmark(uint32_t connections, uint32_t messages, uint32_t size)
+{
+    if (connections > 0)
+    {
+        RunIoBenchmarkRound(connections, messages, size);
+        return;
+    }
+    for (uint32_t count : { 1000, 10000, 30000 })
+    {
+        RunIoBenchmarkRound(count, messages, size);
+    }
+}
@@ -0,0 +1,28 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+
+// Name of the reactor the bot io_contexts were built with ("epoll" or "uring")
+char const* GetIoBackendName();
+// Warns if Bots.IoBackend asks for a backend this build does not have
+void CheckIoBackend();
+
+// Loopback ping-pong over "connections" sockets on the current io backend,
+// "connections" 0 runs 1k, 10k and 30k. Blocks the calling thread.
+void RunIoBenchmark(uint32_t connections, uint32_t messages, uint32_t size);
@@ -0,0 +1,335 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotIoThread.h"
+#include "BotMgr.h"
+#include "BotProfile.h"
+#include "BotPacket.h"
+#include "BotLogging.h"
+
+#include <algorithm>
+#include <cstring>
+
+using boost::asio::ip::tcp;
+
+static constexpr size_t MIN_READ_SIZE = 4096;
+
+BotIoChannel::BotIoChannel(BotThread* logic, BotIoThread* io)
+    : m_logic(logic)
+    , m_io(io)
+{
+}
+
+void BotIoChannel::Send(uint64_t connection, std::vector<uint8_t>&& buffer)
+{
+    BotIoCommand command;
+    command.m_type = BotIoCommand::SEND;
+    command.m_connection = connection;
+    command.m_buffer = std::move(buffer);
+    Push(std::move(command));
+}
+
+void BotIoChannel::Close(uint64_t connection)
+{
+    BotIoCommand command;
+    command.m_type = BotIoCommand::CLOSE;
+    command.m_connection = connection;
+    Push(std::move(command));
+}
+
+void BotIoChannel::Push(BotIoCommand&& command)
+{
+    m_commands.Push(std::move(command));
+    if (!m_commandsScheduled.exchange(true))
+    {
+        boost::asio::post(m_io->m_context, [this]() {
+            // exchange, not store, so the drain sees everything pushed before the flag was set
+            m_commandsScheduled.exchange(false);
+            m_io->DrainCommands(*this);
+        });
+    }
+}
+
+bool BotIoChannel::PopEvent(BotIoEvent& event)
+{
+    return m_events.Pop(event);
+}
+
+void BotIoChannel::PushEvent(BotIoEvent&& event)
+{
+    m_events.Push(std::move(event));
+}
+
+bool BotIoChannel::PopCommand(BotIoCommand& command)
+{
+    return m_commands.Pop(command);
+}
+
+void BotIoChannel::NotifyLogic()
+{
+    if (!m_eventsScheduled.exchange(true))
+    {
+        boost::asio::post(m_logic->m_context, [this]() {
+            m_eventsScheduled.exchange(false);
+            m_logic->DrainIoEvents(*this);
+        });
+    }
+}
+
+BotIoThread::BotIoThread(std::vector<BotThread*> const& logicThreads)
+    : m_work(boost::asio::make_work_guard(m_context))
+{
+    for (BotThread* logic : logicThreads)
+    {
+        m_channels.push_back(std::make_unique<BotIoChannel>(logic, this));
+    }
+}
+
+void BotIoThread::start(int thread)
+{
+    m_threadId = thread;
+    BOT_LOG_DEBUG("BotIoThread", "Starting io thread %i", m_threadId);
+    BotBufferPool::SetCurrent(&m_bufferPool);
+    m_context.run();
+}
+
+BotIoChannel& BotIoThread::GetChannel(uint32_t logicThread)
+{
+    return *m_channels[logicThread];
+}
+
+uint64_t BotIoThread::NextConnectionId()
+{
+    static std::atomic<uint64_t> next = 1;
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BotIoThread::DrainCommands(BotIoChannel& channel)
+{
+    // flush every touched connection once, after the whole batch is queued
+    std::vector<Connection*> touched;
+    BotIoCommand command;
+    while (channel.PopCommand(command))
+    {
+        Execute(channel, command, touched);
+    }
+
+    for (Connection* connection : touched)
+    {
+        Flush(*connection);
+    }
+}
+
+void BotIoThread::Execute(BotIoChannel& channel, BotIoCommand& command, std::vector<Connection*>& touched)
+{
+    if (command.m_type == BotIoCommand::ADOPT)
+    {
+        return Adopt(channel, command);
+    }
+
+    auto itr = m_connections.find(command.m_connection);
+    if (itr == m_connections.end())
+    {
+        BotBufferPool::ReleaseBuffer(std::move(command.m_buffer));
+        return;
+    }
+
+    Connection& connection = *itr->second;
+    if (&channel != connection.m_channel)
+    {
+        // the channels are drained independently, so this can overtake the MOVE
+        connection.m_heldCommands.emplace_back(&channel, std::move(command));
+        return;
+    }
+
+    if (command.m_type == BotIoCommand::CLOSE)
+    {
+        touched.erase(std::remove(touched.begin(), touched.end(), &connection), touched.end());
+        return Disconnect(connection, false);
+    }
+
+    if (command.m_type == BotIoCommand::MOVE)
+    {
+        return Move(connection, command.m_logicThread, touched);
+    }
+
+    connection.m_writeQueue.push_back(std::move(command.m_buffer));
+    if (std::find(touched.begin(), touched.end(), &connection) == touched.end())
+    {
+        touched.push_back(&connection);
+    }
+}
+
+void BotIoThread::Move(Connection& connection, uint32_t logicThread, std::vector<Connection*>& touched)
+{
+    // the old logic thread passes on what it got so far, up to this marker
+    BotIoEvent event;
+    event.m_type = BotIoEvent::MOVED;
+    event.m_connection = connection.m_id;
+    connection.m_channel->PushEvent(std::move(event));
+    connection.m_channel->NotifyLogic();
+    connection.m_channel = m_channels[logicThread].get();
+
+    std::vector<std::pair<BotIoChannel*, BotIoCommand>> held;
+    std::swap(held, connection.m_heldCommands);
+    for (auto& [channel, command] : held)
+    {
+        // may close the connection, or hold the command again if it came from a later move
+        Execute(*channel, command, touched);
+    }
+}
+
+void BotIoThread::Adopt(BotIoChannel& channel, BotIoCommand& command)
+{
+    std::unique_ptr<Connection> connection = std::make_unique<Connection>(m_context);
+    connection->m_id = command.m_connection;
+    connection->m_channel = &channel;
+    connection->m_decrypt = std::move(command.m_decrypt);
+    connection->m_decryptedHeaderBytes = command.m_decryptedHeaderBytes;
+
+    boost::system::error_code ec;
+    connection->m_socket.assign(command.m_v6 ? tcp::v6() : tcp::v4(), command.m_handle, ec);
+    if (ec.failed())
+    {
+        BOT_LOG_ERROR("BotIoThread", "Failed to adopt world socket: %s", ec.message().c_str());
+        BotIoEvent event;
+        event.m_type = BotIoEvent::CLOSED;
+        event.m_connection = command.m_connection;
+        channel.PushEvent(std::move(event));
+        channel.NotifyLogic();
+        return;
+    }
+
+    connection->m_readBuffer.EnsureFreeSpace(command.m_buffer.size());
+    memcpy(connection->m_readBuffer.GetWritePointer(), command.m_buffer.data(), command.m_buffer.size());
+    connection->m_readBuffer.WriteCompleted(command.m_buffer.size());
+
+    Connection& ref = *connection;
+    m_connections[ref.m_id] = std::move(connection);
+    Receive(ref);
+}
+
+void BotIoThread::Receive(Connection& connection)
+{
+    uint8_t const* data = nullptr;
+    size_t size = 0;
+    bool framed = false;
+    for (;;)
+    {
+        WorldPacket::FrameResult result = WorldPacket::FrameWorldPacket(connection.m_readBuffer, connection.m_decryptedHeaderBytes, connection.m_decrypt.get(), data, size);
+        if (result == WorldPacket::FrameResult::INCOMPLETE)
+        {
+            break;
+        }
+        if (result == WorldPacket::FrameResult::MALFORMED)
+        {
+            BOT_LOG_ERROR("BotIoThread", "Connection %llu received a world packet without an opcode", (unsigned long long)connection.m_id);
+            if (framed)
+            {
+                connection.m_channel->NotifyLogic();
+            }
+            return Disconnect(connection, true);
+        }
+
+        BotIoEvent event;
+        event.m_type = BotIoEvent::PACKET;
+        event.m_connection = connection.m_id;
+        event.m_packet = BotBufferPool::AcquireBuffer(size);
+        event.m_packet.insert(event.m_packet.end(), data, data + size);
+        connection.m_channel->PushEvent(std::move(event));
+        framed = true;
+    }
+
+    if (framed)
+    {
+        connection.m_channel->NotifyLogic();
+    }
+    Read(connection);
+}
+
+void BotIoThread::Read(Connection& connection)
+{
+    connection.m_readBuffer.Normalize();
+    connection.m_readBuffer.EnsureFreeSpace(MIN_READ_SIZE);
+    uint64_t id = connection.m_id;
+    connection.m_socket.async_read_some(boost::asio::buffer(connection.m_readBuffer.GetWritePointer(), connection.m_readBuffer.GetRemainingSpace()), [this, id](boost::system::error_code const& ec, size_t len) {
+        auto itr = m_connections.find(id);
+        if (itr == m_connections.end())
+        {
+            return;
+        }
+        Connection& connection = *itr->second;
+        if (ec.failed())
+        {
+            return Disconnect(connection, true);
+        }
+        connection.m_readBuffer.WriteCompleted(len);
+        Receive(connection);
+    });
+}
+
+void BotIoThread::Flush(Connection& connection)
+{
+    if (connection.m_writing || connection.m_writeQueue.empty())
+    {
+        return;
+    }
+
+    connection.m_writing = true;
+    std::swap(connection.m_writeQueue, connection.m_writesInFlight);
+    connection.m_writeBuffers.clear();
+    for (std::vector<uint8_t> const& buffer : connection.m_writesInFlight)
+    {
+        connection.m_writeBuffers.push_back(boost::asio::buffer(buffer));
+    }
+
+    uint64_t id = connection.m_id;
+    boost::asio::async_write(connection.m_socket, connection.m_writeBuffers, [this, id](boost::system::error_code const& ec, size_t) {
+        auto itr = m_connections.find(id);
+        if (itr == m_connections.end())
+        {
+            return;
+        }
+        Connection& connection = *itr->second;
+        connection.m_writing = false;
+        for (std::vector<uint8_t>& buffer : connection.m_writesInFlight)
+        {
+            BotBufferPool::ReleaseBuffer(std::move(buffer));
+        }
+        connection.m_writesInFlight.clear();
+        if (ec.failed())
+        {
+            return Disconnect(connection, true);
+        }
+        Flush(connection);
+    });
+}
+
+void BotIoThread::Disconnect(Connection& connection, bool notifyLogic)
+{
+    if (notifyLogic)
+    {
+        BotIoEvent event;
+        event.m_type = BotIoEvent::CLOSED;
+        event.m_connection = connection.m_id;
+        connection.m_channel->PushEvent(std::move(event));
+        connection.m_channel->NotifyLogic();
+    }
+    boost::system::error_code ec;
+    connection.m_socket.close(ec);
+    // pending handlers look the connection up by id and find nothing
+    m_connections.erase(connection.m_id);
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "ARC4.h"
+#include "BotBufferPool.h"
+#include "BotReceiveBuffer.h"
+#include "BotSpscQueue.h"
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class BotThread;
+class BotIoThread;
+
+// Logic thread -> io thread
+struct BotIoCommand
+{
+    enum Type
+    {
+        ADOPT,
+        SEND,
+        CLOSE,
+        // the bot moved to another logic thread, events go to m_logicThread from now on
+        MOVE
+    };
+    Type m_type = SEND;
+    uint64_t m_connection = 0;
+    uint32_t m_logicThread = 0;
+    // SEND: encrypted packet, ADOPT: bytes the logic thread already read but did not frame
+    std::vector<uint8_t> m_buffer;
+    boost::asio::ip::tcp::socket::native_handle_type m_handle = {};
+    bool m_v6 = false;
+    uint32_t m_decryptedHeaderBytes = 0;
+    std::unique_ptr<Trinity::Crypto::ARC4> m_decrypt;
+};
+
+// Io thread -> logic thread
+struct BotIoEvent
+{
+    enum Type
+    {
+        PACKET,
+        CLOSED,
+        // the last event sent to the old logic thread of a moved connection
+        MOVED
+    };
+    Type m_type = PACKET;
+    uint64_t m_connection = 0;
+    // opcode followed by the payload
+    std::vector<uint8_t> m_packet;
+};
+
+// The pair of queues between one io thread and one logic thread.
+// Each side posts a drain to the other sides io_context once per batch.
+class BotIoChannel
+{
+public:
+    BotIoChannel(BotThread* logic, BotIoThread* io);
+    // logic thread
+    void Send(uint64_t connection, std::vector<uint8_t>&& buffer);
+    void Close(uint64_t connection);
+    void Push(BotIoCommand&& command);
+    bool PopEvent(BotIoEvent& event);
+    // io thread
+    void PushEvent(BotIoEvent&& event);
+    bool PopCommand(BotIoCommand& command);
+    void NotifyLogic();
+private:
+    BotThread* m_logic;
+    BotIoThread* m_io;
+    BotSpscQueue<BotIoCommand> m_commands;
+    BotSpscQueue<BotIoEvent> m_events;
+    std::atomic<bool> m_commandsScheduled = false;
+    std::atomic<bool> m_eventsScheduled = false;
+    friend class BotIoThread;
+};
+
+// Owns world sockets in pipelined mode (Bots.IoThreadCount > 0): reads, decrypts
+// and frames packets for the logic BotThreads and writes their outbound packets.
+class BotIoThread
+{
+public:
+    BotIoThread(std::vector<BotThread*> const& logicThreads);
+    void start(int thread);
+    BotIoChannel& GetChannel(uint32_t logicThread);
+    static uint64_t NextConnectionId();
+private:
+    struct Connection
+    {
+        Connection(boost::asio::io_context& ctx) : m_socket(ctx) {}
+        uint64_t m_id = 0;
+        BotIoChannel* m_channel = nullptr;
+        boost::asio::ip::tcp::socket m_socket;
+        BotReceiveBuffer m_readBuffer;
+        uint32_t m_decryptedHeaderBytes = 0;
+        std::unique_ptr<Trinity::Crypto::ARC4> m_decrypt;
+        std::vector<std::vector<uint8_t>> m_writeQueue;
+        std::vector<std::vector<uint8_t>> m_writesInFlight;
+        std::vector<boost::asio::const_buffer> m_writeBuffers;
+        bool m_writing = false;
+        // commands from the logic thread a bot moved to, sent before its MOVE got here
+        std::vector<std::pair<BotIoChannel*, BotIoCommand>> m_heldCommands;
+    };
+    void DrainCommands(BotIoChannel& channel);
+    void Execute(BotIoChannel& channel, BotIoCommand& command, std::vector<Connection*>& touched);
+    void Move(Connection& connection, uint32_t logicThread, std::vector<Connection*>& touched);
+    void Adopt(BotIoChannel& channel, BotIoCommand& command);
+    // frames what is buffered, then reads more
+    void Receive(Connection& connection);
+    void Read(Connection& connection);
+    void Flush(Connection& connection);
+    void Disconnect(Connection& connection, bool notifyLogic);
+    uint32_t m_threadId = UINT32_MAX;
+    boost::asio::io_context m_context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+    std::vector<std::unique_ptr<BotIoChannel>> m_channels;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> m_connections;
+    BotBufferPool m_bufferPool;
+    friend class BotIoChannel;
+};
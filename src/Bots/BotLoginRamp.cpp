@@ -0,0 +1,167 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotLoginRamp.h"
+#include "BotLogging.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <chrono>
+
+static uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BotLoginRamp* BotLoginRamp::instance()
+{
+    static BotLoginRamp ramp;
+    return &ramp;
+}
+
+void BotLoginRamp::Load()
+{
+    std::scoped_lock lock(m_mutex);
+    m_rate = std::max(sConfigMgr->GetIntDefault("Bots.LoginRate", 100), 0);
+    m_burst = std::max(sConfigMgr->GetIntDefault("Bots.LoginBurst", 100), 1);
+    m_maxInFlight = std::max(sConfigMgr->GetIntDefault("Bots.MaxConcurrentHandshakes", 200), 0);
+    m_tokens = m_burst;
+    m_lastRefill = now();
+    BOT_LOG_DEBUG("LoginRamp", "Admitting %.0f logins/s (burst %.0f), %u concurrent handshakes", m_rate, m_burst, m_maxInFlight);
+}
+
+bool BotLoginRamp::TryAdmit()
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_maxInFlight > 0 && m_inFlight >= m_maxInFlight)
+    {
+        return false;
+    }
+    if (m_rate > 0)
+    {
+        uint64_t time = now();
+        m_tokens = std::min(m_burst, m_tokens + (time - m_lastRefill) * m_rate / 1000.0);
+        m_lastRefill = time;
+        if (m_tokens < 1)
+        {
+            return false;
+        }
+        m_tokens -= 1;
+    }
+    m_inFlight++;
+    return true;
+}
+
+void BotLoginRamp::Release(uint64_t latency, uint64_t timeToWorld, bool success)
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_inFlight > 0)
+    {
+        m_inFlight--;
+    }
+    if (!success)
+    {
+        m_failed++;
+        return;
+    }
+    m_succeeded++;
+    m_handshakes.Add(latency);
+    m_toWorld.Add(timeToWorld);
+}
+
+void BotLoginRamp::Latencies::Add(uint64_t latency)
+{
+    m_sum += latency;
+    m_max = std::max(m_max, latency);
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && latency > (uint64_t(1) << bucket))
+    {
+        bucket++;
+    }
+    m_buckets[bucket]++;
+}
+
+void BotLoginRamp::AddQueued(int32_t count)
+{
+    m_queued += count;
+}
+
+uint32_t BotLoginRamp::Latencies::GetPercentile(uint32_t count, float percentile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint32_t target = uint32_t(count * percentile);
+    uint32_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen > target)
+        {
+            return std::min<uint64_t>(uint64_t(1) << i, m_max);
+        }
+    }
+    return uint32_t(m_max);
+}
+
+BotLoginRamp::Stats BotLoginRamp::GetStats()
+{
+    std::scoped_lock lock(m_mutex);
+    return ReadStats();
+}
+
+void BotLoginRamp::ResetStats()
+{
+    std::scoped_lock lock(m_mutex);
+    ClearStats();
+}
+
+BotLoginRamp::Stats BotLoginRamp::TakeStats()
+{
+    std::scoped_lock lock(m_mutex);
+    Stats stats = ReadStats();
+    ClearStats();
+    return stats;
+}
+
+BotLoginRamp::Stats BotLoginRamp::ReadStats() const
+{
+    Stats stats;
+    stats.m_queued = uint32_t(std::max(m_queued.load(), 0));
+    stats.m_inFlight = m_inFlight;
+    stats.m_maxInFlight = m_maxInFlight;
+    stats.m_succeeded = m_succeeded;
+    stats.m_failed = m_failed;
+    stats.m_average = m_succeeded > 0 ? uint32_t(m_handshakes.m_sum / m_succeeded) : 0;
+    stats.m_p50 = m_handshakes.GetPercentile(m_succeeded, 0.5f);
+    stats.m_p95 = m_handshakes.GetPercentile(m_succeeded, 0.95f);
+    stats.m_max = uint32_t(m_handshakes.m_max);
+    stats.m_worldAverage = m_succeeded > 0 ? uint32_t(m_toWorld.m_sum / m_succeeded) : 0;
+    stats.m_worldP50 = m_toWorld.GetPercentile(m_succeeded, 0.5f);
+    stats.m_worldP95 = m_toWorld.GetPercentile(m_succeeded, 0.95f);
+    stats.m_worldMax = uint32_t(m_toWorld.m_max);
+    return stats;
+}
+
+void BotLoginRamp::ClearStats()
+{
+    m_succeeded = 0;
+    m_failed = 0;
+    m_handshakes = {};
+    m_toWorld = {};
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Admission control for logins across all bot threads. A token bucket limits how many
+// handshakes start per second (Bots.LoginRate, Bots.LoginBurst) and at most
+// Bots.MaxConcurrentHandshakes run at once, so starting many bots ramps up at the rate
+// the authserver can take instead of opening every connection on the same tick.
+class BotLoginRamp
+{
+public:
+    struct Stats
+    {
+        uint32_t m_queued;
+        uint32_t m_inFlight;
+        uint32_t m_maxInFlight;
+        uint32_t m_succeeded;
+        uint32_t m_failed;
+        // handshake latency of successful logins in ms
+        uint32_t m_average;
+        uint32_t m_p50;
+        uint32_t m_p95;
+        uint32_t m_max;
+        // ms from StartBot to in world, including the wait for admission
+        uint32_t m_worldAverage;
+        uint32_t m_worldP50;
+        uint32_t m_worldP95;
+        uint32_t m_worldMax;
+    };
+    static BotLoginRamp* instance();
+    void Load();
+    // Takes a token and a handshake slot, false if either is unavailable
+    bool TryAdmit();
+    // Gives back the slot of an admitted handshake, latencies are recorded for successful ones
+    void Release(uint64_t latency, uint64_t timeToWorld, bool success);
+    // Bots waiting for admission on all threads
+    void AddQueued(int32_t count);
+    // Counters since the last reset
+    Stats GetStats();
+    void ResetStats();
+    // GetStats followed by ResetStats
+    Stats TakeStats();
+private:
+    // upper bounds of the latency histogram are powers of two, up to ~2 minutes
+    static constexpr size_t LATENCY_BUCKETS = 18;
+    struct Latencies
+    {
+        uint64_t m_sum = 0;
+        uint64_t m_max = 0;
+        std::array<uint32_t, LATENCY_BUCKETS> m_buckets = {};
+        void Add(uint64_t latency);
+        uint32_t GetPercentile(uint32_t count, float percentile) const;
+    };
+    // callers hold m_mutex
+    Stats ReadStats() const;
+    void ClearStats();
+    std::mutex m_mutex;
+    double m_rate = 0;
+    double m_burst = 0;
+    double m_tokens = 0;
+    uint64_t m_lastRefill = 0;
+    uint32_t m_maxInFlight = 0;
+    uint32_t m_inFlight = 0;
+    std::atomic<int32_t> m_queued = 0;
+    uint32_t m_succeeded = 0;
+    uint32_t m_failed = 0;
+    Latencies m_handshakes;
+    Latencies m_toWorld;
+};
+
+#define sBotLoginRamp BotLoginRamp::instance()
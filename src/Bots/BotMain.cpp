@@ -20,6 +20,12 @@
 #include "BotProfile.h"
 #include "BotLogging.h"
 #include "BotAccounts.h"
+#include "BotSourceAddresses.h"
+#include "BotResolver.h"
+#include "BotCrypto.h"
+#include "BotCredentialCache.h"
+#include "BotLoginRamp.h"
+#include "BotWarmPool.h"
 #include "Map/BotMapDataMgr.h"
 
 #include "Config.h"
@@ -41,6 +47,12 @@ void TC_BOT_API BotMain()
 
     ReloadAccounts();
     sBotMapDataMgr->Setup();
+    sBotSourceAddressPool->Load();
+    sBotResolverCache->Load();
+    sBotCryptoPool->Load();
+    sBotCredentialCache->Load();
+    sBotLoginRamp->Load();
+    BotWarmPool::Load();
     sBotMgr->Initialize();
     sBotCommandMgr->Reload();
     if (sConfigMgr->GetBoolDefault("Console.Enable", true))
@@ -20,6 +20,11 @@
 #include "BotProfile.h"
 #include "BotProfileLua.h"
 #include "BotLogging.h"
+#include "BotIoBackend.h"
+#include "BotIoThread.h"
+#include "BotLoginRamp.h"
+#include "BotCrypto.h"
+#include "BotPacket.h"
 #include "Config.h"
 #include "BehaviorTree.h"
 
@@ -40,77 +45,150 @@ void BotThread::run()
 {
     m_timer.expires_from_now(boost::posix_time::millisec(50));
     m_timer.async_wait(boost::bind(&BotThread::run, this));
+    uint64_t tickStart = GetCostClock();
+    uint64_t time = now();
+    m_timers.Advance(time);
 
-    for (auto& [_, bot] : m_botsWithAI)
+    // only the bots with a behavior tree, packed. A reload from a behavior can change the
+    // list, so it is walked by index.
+    std::vector<Bot*> const& behaviorBots = m_bots.GetBehaviorBots();
+    for (size_t i = 0; i < behaviorBots.size(); ++i)
     {
-        if (bot->m_behavior)
+        Bot* bot = behaviorBots[i];
+        uint64_t start = GetCostClock();
+        bot->m_behavior->Update(*bot, now());
+        bot->m_cost += GetCostClock() - start;
+    }
+
+    m_balanceTicks++;
+    if (m_balanceInterval > 0 && time >= m_nextBalance)
+    {
+        if (m_nextBalance > 0)
         {
-            bot->m_behavior->Update(*bot, now());
+            Balance();
         }
+        m_nextBalance = time + m_balanceInterval;
     }
 
-    if (m_queuedLogins.size() > 0 || m_queuedRemoves.size() > 0 || m_shouldReload)
+    ExecuteCommands();
+    // an ADOPT is queued before the first event of its connection, so the rest belong to closed ones
+    for (auto& [connection, events] : m_earlyIoEvents)
     {
-        std::scoped_lock lock(sBotMgr->m_botMutex);
-        for (std::string const& str : m_queuedLogins)
+        for (BotIoEvent& event : events)
         {
-            auto itr = sBotMgr->m_bots.find(str);
-            if (itr == sBotMgr->m_bots.end())
-            {
-                continue;
-            }
-            Bot* bot = itr->second.get();
-            if (bot->m_thread != this || bot->m_disconnected)
+            BotBufferPool::ReleaseBuffer(std::move(event.m_packet));
+        }
+    }
+    m_earlyIoEvents.clear();
+
+    // logins start as fast as the ramp admits them, the rest wait for a later tick
+    while (m_pendingLogins.size() > 0)
+    {
+        Bot* bot = m_bots.Get(m_pendingLogins.front());
+        if (bot && !bot->m_disconnected)
+        {
+            if (!sBotLoginRamp->TryAdmit())
             {
-                continue;
+                break;
             }
             bot->LoadScripts();
             bot->Connect();
         }
-        m_queuedLogins.clear();
+        m_pendingLogins.pop_front();
+        sBotLoginRamp->AddQueued(-1);
+    }
 
-        for (std::string const& str : m_queuedRemoves)
+    // the warm pool connects ahead for the logins that are next in line
+    std::vector<BotWarmPool::Login> warmLogins;
+    uint32_t warmSize = BotWarmPool::GetSize();
+    for (size_t i = 0; i < m_pendingLogins.size() && warmLogins.size() < warmSize; ++i)
+    {
+        if (Bot* bot = m_bots.Get(m_pendingLogins[i]))
         {
-            auto itr = sBotMgr->m_bots.find(str);
-            if (itr == sBotMgr->m_bots.end())
-            {
-                continue;
-            }
-            Bot* bot = itr->second.get();
-            if (bot->m_thread != this || !bot->m_disconnected)
-            {
-                continue;
-            }
-            if (bot->m_behavior != nullptr)
-            {
-                m_botsWithAI.erase(str);
-            }
-            bot->DisconnectNow();
-            sBotMgr->m_bots.erase(str);
+            warmLogins.emplace_back(bot->m_authserverIp, bot->GetSourceHint());
+        }
+    }
+
+    m_warmPool.Update(time, warmLogins);
+
+    // packets are handled between ticks, so they count towards the next one
+    uint64_t cost = GetCostClock() - tickStart + m_packetCost;
+    m_packetCost = 0;
+    m_tickCost = (m_tickCost.load(std::memory_order_relaxed) * 15 + cost) / 16;
+}
+
+uint64_t BotThread::GetCostClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t BotThread::GetTickCost() const
+{
+    return m_tickCost.load(std::memory_order_relaxed);
+}
+
+void BotThread::Balance()
+{
+    uint32_t ticks = std::max(m_balanceTicks, 1u);
+    m_balanceTicks = 0;
+    std::vector<std::pair<uint64_t, Bot*>> candidates;
+    for (Bot* bot : m_bots.GetBots())
+    {
+        // per tick, like the thread cost
+        uint64_t cost = bot->m_cost / ticks;
+        bot->m_cost = 0;
+        if (bot->CanMigrateLive() && !bot->m_migrateTarget && !bot->m_disconnected)
+        {
+            candidates.emplace_back(cost, bot);
         }
+    }
 
-        if (m_shouldReload)
+    BotThread* target = nullptr;
+    for (std::unique_ptr<BotThread>& thread : sBotMgr->m_threads)
+    {
+        if (!target || thread->GetTickCost() < target->GetTickCost())
         {
-            for (auto& bot : sBotMgr->m_bots)
-            {
-                if (bot.second->m_thread == this)
-                {
-                    bot.second->UnloadScripts();
-                }
-            }
-            m_botsWithAI.clear();
-            m_events->Reset();
-            m_lua = std::make_unique<BotProfileLua>(this);
-            m_lua->Start();
-            for (auto& bot : sBotMgr->m_bots)
-            {
-                if (bot.second->m_thread == this)
-                {
-                    bot.second->LoadScripts();
-                }
-            }
-            m_shouldReload = false;
+            target = thread.get();
+        }
+    }
+    uint64_t cost = GetTickCost();
+    if (!target || target == this || cost < m_balanceMinCost || cost < target->GetTickCost() * m_balanceThreshold)
+    {
+        return;
+    }
+
+    // move half the difference, so the two threads meet in the middle
+    uint64_t excess = (cost - target->GetTickCost()) / 2;
+    std::sort(candidates.begin(), candidates.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+    uint32_t moved = 0;
+    uint64_t movedCost = 0;
+    for (auto& [botCost, bot] : candidates)
+    {
+        if (moved >= m_balanceMaxBots || movedCost >= excess)
+        {
+            break;
+        }
+        // a bot that costs more than what is left would just make the target the hot thread
+        if (botCost == 0 || movedCost + botCost > excess)
+        {
+            continue;
         }
+        StartMigration(bot, target);
+        moved++;
+        movedCost += botCost;
+    }
+
+    if (moved > 0)
+    {
+        BOT_LOG_DEBUG("BotThread", "Thread %u (%llu us per tick) moves %u bots (%llu us) to thread %u (%llu us per tick)"
+            , m_threadId
+            , (unsigned long long)(cost / 1000)
+            , moved
+            , (unsigned long long)(movedCost / 1000)
+            , target->m_threadId
+            , (unsigned long long)(target->GetTickCost() / 1000)
+        );
     }
 }
 
@@ -118,19 +196,259 @@ BotThread::BotThread()
     : m_events(std::make_unique<BotProfileMgr>())
     , m_threadId(UINT32_MAX)
     , m_context()
+    , m_timers(50)
+    , m_warmPool(m_context)
     , m_timer(m_context,boost::posix_time::millisec(50))
 {
+    // starts the lua state on the first tick
+    Reload();
 }
 
 void BotThread::Reload()
 {
-    m_shouldReload = true;
+    BotThreadCommand command;
+    command.m_type = BotThreadCommand::Type::RELOAD;
+    PushCommand(std::move(command));
+}
+
+void BotThread::PushCommand(BotThreadCommand&& command)
+{
+    m_commands.Push(std::move(command));
+}
+
+void BotThread::ExecuteCommands()
+{
+    BotThreadCommand command;
+    while (m_commands.Pop(command))
+    {
+        auto migrated = m_migratedBots.find(command.m_username);
+        if (migrated != m_migratedBots.end() && command.m_type != BotThreadCommand::Type::ADOPT)
+        {
+            // sent before BotMgr learned where the bot went
+            migrated->second->PushCommand(std::move(command));
+            continue;
+        }
+
+        switch (command.m_type)
+        {
+            case BotThreadCommand::Type::LOGIN:
+                OnLogin(command);
+                break;
+            case BotThreadCommand::Type::LOGOUT:
+                OnLogout(command);
+                break;
+            case BotThreadCommand::Type::RELOAD:
+                OnReload();
+                break;
+            case BotThreadCommand::Type::MIGRATE:
+                OnMigrate(command);
+                break;
+            case BotThreadCommand::Type::ADOPT:
+                OnAdopt(command);
+                break;
+            case BotThreadCommand::Type::IO_EVENT:
+                DispatchIoEvent(command.m_ioEvent, true);
+                break;
+        }
+    }
+}
+
+void BotThread::OnLogin(BotThreadCommand& command)
+{
+    Bot* bot = m_bots.Find(command.m_username);
+    if (!bot)
+    {
+        bot = m_bots.Get(m_bots.Insert(std::make_unique<Bot>(this, command.m_username, command.m_password, command.m_events, command.m_authserver)));
+    }
+    bot->m_disconnected = false;
+    bot->m_loginQueuedTime = command.m_queuedTime;
+    QueueLogin(bot->m_id);
+}
+
+void BotThread::OnLogout(BotThreadCommand& command)
+{
+    Bot* bot = m_bots.Find(command.m_username);
+    if (!bot)
+    {
+        return;
+    }
+    bot->m_disconnected = true;
+    bot->DisconnectNow();
+    m_bots.Remove(bot->m_id);
+}
+
+void BotThread::OnReload()
+{
+    for (Bot* bot : m_bots.GetBots())
+    {
+        bot->UnloadScripts();
+    }
+    m_events->Reset();
+    m_lua = std::make_unique<BotProfileLua>(this);
+    m_lua->Start();
+    for (Bot* bot : m_bots.GetBots())
+    {
+        bot->LoadScripts();
+    }
+}
+
+void BotThread::OnMigrate(BotThreadCommand& command)
+{
+    Bot* bot = m_bots.Find(command.m_username);
+    // a bot that is logging out is removed by the LOGOUT that follows
+    if (!bot || bot->m_disconnected || bot->m_migrateTarget || command.m_target == this)
+    {
+        return;
+    }
+    StartMigration(bot, command.m_target);
+}
+
+void BotThread::StartMigration(Bot* bot, BotThread* target)
+{
+    if (!bot->CanMigrateLive())
+    {
+        bot->DisconnectNow();
+        return ReleaseBot(bot, target, false);
+    }
+    bot->m_migrateTarget = target;
+    bot->ContinueMigration();
+}
+
+void BotThread::ReleaseBot(Bot* bot, BotThread* target, bool live)
+{
+    BotThreadCommand adopt;
+    adopt.m_type = BotThreadCommand::Type::ADOPT;
+    adopt.m_username = bot->m_username;
+    adopt.m_live = live;
+    BotIoChannel* moveChannel = nullptr;
+    BotIoCommand move;
+    adopt.m_login = !live;
+    if (live)
+    {
+        // the connections stay up, only what is tied to this thread's timers, engine and io_context moves
+        m_timers.Cancel(bot->m_timeoutTimer);
+        bot->m_timeoutTimer = 0;
+        if (bot->m_encryptStream != BotArc4Engine::NONE)
+        {
+            m_arc4.Flush();
+            adopt.m_encrypt = m_arc4.Export(bot->m_encryptStream);
+            m_arc4.Destroy(bot->m_encryptStream);
+            bot->m_encryptStream = BotArc4Engine::NONE;
+        }
+        if (bot->m_authSocket.has_value())
+        {
+            adopt.m_authHandle = bot->m_authSocket->Release();
+        }
+        BotSocket& world = bot->m_worldSocket.value();
+        if (uint64_t connection = world.GetIoConnection())
+        {
+            if (world.IsOpen())
+            {
+                m_pipelinedBots.erase(connection);
+                m_movedConnections[connection] = target;
+            }
+            moveChannel = world.MoveIo(sBotMgr->GetIoChannel(*target, connection), target->m_threadId, move);
+        }
+        adopt.m_worldHandle = world.Release();
+        if (bot->m_data.valid())
+        {
+            adopt.m_data = BotLuaValue::Copy(bot->m_data);
+        }
+    }
+
+    // lua state and behavior tree belong to this thread, the target loads its own
+    bot->UnloadScripts();
+    bot->m_behavior = nullptr;
+    m_bots.UpdateBehavior(bot->m_id);
+    bot->m_cached_events = BotProfile();
+    bot->m_migrateTarget = nullptr;
+    bot->m_thread = target;
+    m_migratedBots[bot->m_username] = target;
+    adopt.m_bot = m_bots.Remove(bot->m_id);
+    target->PushCommand(std::move(adopt));
+    // the io thread routes events to the target once it has the MOVE, by then the ADOPT is in
+    // the target's inbox and events that arrive before it ran wait in m_earlyIoEvents
+    if (moveChannel)
+    {
+        moveChannel->Push(std::move(move));
+    }
+}
+
+void BotThread::OnAdopt(BotThreadCommand& command)
+{
+    m_migratedBots.erase(command.m_username);
+    Bot* bot = m_bots.Get(m_bots.Insert(std::move(command.m_bot)));
+    sBotMgr->OnBotMigrated(command.m_username, this);
+    if (command.m_login)
+    {
+        QueueLogin(bot->m_id);
+    }
+    if (!command.m_live)
+    {
+        return;
+    }
+
+    bot->LoadBehavior();
+    if (command.m_data.has_value())
+    {
+        m_lua->SetBotData(bot, command.m_data.value());
+    }
+    if (command.m_encrypt.has_value())
+    {
+        bot->m_encryptStream = m_arc4.Import(command.m_encrypt.value());
+    }
+    if (bot->m_authSocket.has_value())
+    {
+        bot->m_authSocket->Rebind(m_context, command.m_authHandle);
+        bot->ApplyImpairment(bot->m_authSocket.value());
+    }
+
+    BotSocket& world = bot->m_worldSocket.value();
+    world.Rebind(m_context, command.m_worldHandle);
+    bot->ApplyImpairment(world);
+    bot->ArmTimeout(BotTimeoutPhase::IDLE);
+    if (uint64_t connection = world.GetIoConnection())
+    {
+        if (world.IsOpen())
+        {
+            m_pipelinedBots[connection] = bot;
+            std::vector<BotIoEvent>& held = m_heldIoEvents[connection];
+            auto early = m_earlyIoEvents.find(connection);
+            if (early != m_earlyIoEvents.end())
+            {
+                held = std::move(early->second);
+                m_earlyIoEvents.erase(early);
+            }
+        }
+    }
+    else
+    {
+        bot->ReadWorld();
+    }
+}
+
+void BotThread::QueueLogin(BotId id)
+{
+    m_pendingLogins.push_back(id);
+    sBotLoginRamp->AddQueued(1);
 }
 
 void BotThread::start(int thread)
 {
     m_threadId = thread;
     BOT_LOG_DEBUG("BotThread", "Starting bot thread %i", m_threadId);
+    BotBufferPool::SetCurrent(&m_bufferPool);
+    BotArc4Engine::SetCurrent(&m_arc4);
+    m_timeouts[uint32_t(BotTimeoutPhase::CONNECT)] = std::max(sConfigMgr->GetIntDefault("Bots.ConnectTimeout", 10000), 0);
+    m_timeouts[uint32_t(BotTimeoutPhase::HANDSHAKE)] = std::max(sConfigMgr->GetIntDefault("Bots.HandshakeTimeout", 30000), 0);
+    m_timeouts[uint32_t(BotTimeoutPhase::IDLE)] = std::max(sConfigMgr->GetIntDefault("Bots.IdleTimeout", 120000), 0);
+    m_requeueOnTimeout = sConfigMgr->GetBoolDefault("Bots.RequeueOnTimeout", false);
+    m_authReconnect = sConfigMgr->GetBoolDefault("Bots.AuthReconnect", true);
+    m_balanceInterval = std::max(sConfigMgr->GetIntDefault("Bots.BalanceInterval", 0), 0);
+    m_balanceThreshold = sConfigMgr->GetFloatDefault("Bots.BalanceThreshold", 1.25f);
+    m_balanceMinCost = uint64_t(std::max(sConfigMgr->GetIntDefault("Bots.BalanceMinCost", 2000), 0)) * 1000;
+    m_balanceMaxBots = std::max(sConfigMgr->GetIntDefault("Bots.BalanceMaxBots", 20), 0);
+    m_random.seed(std::random_device()() ^ uint32_t(thread));
     run();
     m_context.run();
 }
@@ -141,18 +459,46 @@ BotMgr* BotMgr::instance()
     return &mgr;
 }
 
+BotMgr::BotMgr()
+{
+    // constructed first, so the crypto pool is still there when ~BotMgr stops it
+    sBotCryptoPool;
+}
+
+BotMgr::~BotMgr()
+{
+    // crypto jobs post their results to the io_contexts of the bot threads
+    sBotCryptoPool->Stop();
+}
+
+static std::string NormalizeUsername(std::string username)
+{
+    // bots uppercase their name, so threads find them by it
+    std::transform(username.begin(), username.end(), username.begin(), [](uint8_t c) { return std::toupper(c); });
+    return username;
+}
+
 void BotMgr::StartBot(std::string const& username, std::string const& password, std::string const& events, std::string const& authserver)
 {
     std::scoped_lock lock(m_botMutex);
-    auto old = m_bots.find(username);
+    BotThreadCommand command;
+    command.m_type = BotThreadCommand::Type::LOGIN;
+    command.m_username = NormalizeUsername(username);
+    command.m_password = password;
+    command.m_events = events;
+    command.m_authserver = authserver;
+    command.m_queuedTime = std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    auto old = m_bots.find(command.m_username);
     if (old != m_bots.end())
     {
-        if (old->second->m_disconnected)
+        if (!old->second.m_active)
         {
-            old->second->m_disconnected = false;
-            old->second->m_thread->m_bot_count++;
+            old->second.m_active = true;
+            old->second.m_thread->m_bot_count++;
         }
-        old->second->m_thread->m_queuedLogins.push_back(username);
+        old->second.m_thread->PushCommand(std::move(command));
         return;
     }
     BotThread* cur = nullptr;
@@ -167,41 +513,213 @@ void BotMgr::StartBot(std::string const& username, std::string const& password,
     {
         return;
     }
-    m_bots[username] = std::make_unique<Bot>(cur, username, password, events, authserver);
-    cur->m_queuedLogins.push_back(username);
+    m_bots[command.m_username] = { cur, true };
     cur->m_bot_count++;
+    cur->PushCommand(std::move(command));
 }
 
 void BotMgr::StopBot(std::string const& username)
+{
+    std::scoped_lock lock(m_botMutex);
+    auto bot = m_bots.find(NormalizeUsername(username));
+    if (bot == m_bots.end() || !bot->second.m_active)
+    {
+        return;
+    }
+    bot->second.m_active = false;
+    bot->second.m_thread->m_bot_count--;
+    BotThreadCommand command;
+    command.m_type = BotThreadCommand::Type::LOGOUT;
+    command.m_username = bot->first;
+    bot->second.m_thread->PushCommand(std::move(command));
+}
+
+void BotMgr::MigrateBot(std::string const& username, uint32_t thread)
+{
+    std::scoped_lock lock(m_botMutex);
+    auto bot = m_bots.find(NormalizeUsername(username));
+    if (bot == m_bots.end() || !bot->second.m_active || thread >= m_threads.size())
+    {
+        return;
+    }
+    BotThreadCommand command;
+    command.m_type = BotThreadCommand::Type::MIGRATE;
+    command.m_username = bot->first;
+    command.m_target = m_threads[thread].get();
+    // commands keep going to the old thread until the new one took the bot, which passes them on
+    bot->second.m_thread->PushCommand(std::move(command));
+}
+
+void BotMgr::OnBotMigrated(std::string const& username, BotThread* thread)
 {
     std::scoped_lock lock(m_botMutex);
     auto bot = m_bots.find(username);
-    if (bot == m_bots.end() || bot->second->m_disconnected)
+    if (bot == m_bots.end() || bot->second.m_thread == thread)
     {
         return;
     }
-    bot->second->QueueDisconnect();
+    if (bot->second.m_active)
+    {
+        bot->second.m_thread->m_bot_count--;
+        thread->m_bot_count++;
+    }
+    bot->second.m_thread = thread;
 }
 
 void BotMgr::Initialize()
 {
+    CheckIoBackend();
     int threadCount = sConfigMgr->GetIntDefault("Bots.ThreadCount", 1);
     m_threads.resize(threadCount);
+    std::vector<BotThread*> logicThreads;
     for (int i = 0; i < threadCount; ++i)
     {
         BotThread* thread = (m_threads[i] = std::make_unique<BotThread>()).get();
-        std::thread(&BotThread::start, thread, i).detach();
+        thread->m_threadId = i;
+        logicThreads.push_back(thread);
     }
+
+    int ioThreadCount = sConfigMgr->GetIntDefault("Bots.IoThreadCount", 0);
+    for (int i = 0; i < ioThreadCount; ++i)
+    {
+        m_ioThreads.push_back(std::make_unique<BotIoThread>(logicThreads));
+        std::thread(&BotIoThread::start, m_ioThreads.back().get(), i).detach();
+    }
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        std::thread(&BotThread::start, m_threads[i].get(), i).detach();
+    }
+}
+
+bool BotMgr::IsPipelined() const
+{
+    return m_ioThreads.size() > 0;
+}
+
+BotIoChannel& BotMgr::GetIoChannel(BotThread& logic, uint64_t connection)
+{
+    return m_ioThreads[connection % m_ioThreads.size()]->GetChannel(logic.m_threadId);
 }
 
 void BotMgr::Reload()
 {
     for (std::unique_ptr<BotThread>& thread : m_threads)
     {
-        thread->m_shouldReload = true;
+        thread->Reload();
+    }
+}
+
+void BotMgr::LogStats()
+{
+    BotLoginRamp::Stats logins = sBotLoginRamp->TakeStats();
+    BOT_LOG_INFO("stats", "Logins: %u queued, %u handshakes in flight (max %u), %u succeeded / %u failed since last stats, latency avg %u ms, p50 %u ms, p95 %u ms, max %u ms"
+        , logins.m_queued
+        , logins.m_inFlight
+        , logins.m_maxInFlight
+        , logins.m_succeeded
+        , logins.m_failed
+        , logins.m_average
+        , logins.m_p50
+        , logins.m_p95
+        , logins.m_max
+    );
+    for (std::unique_ptr<BotThread>& thread : m_threads)
+    {
+        uint64_t hits = thread->m_bufferPool.GetHits();
+        uint64_t misses = thread->m_bufferPool.GetMisses();
+        BOT_LOG_INFO("stats", "Thread %u: %i bots, %llu us per tick, buffer pool %llu hits / %llu misses"
+            , thread->m_threadId
+            , thread->m_bot_count.load()
+            , (unsigned long long)(thread->GetTickCost() / 1000)
+            , (unsigned long long)hits
+            , (unsigned long long)misses
+        );
+    }
+}
+
+uint32_t BotThread::GetTimeout(BotTimeoutPhase phase) const
+{
+    return m_timeouts[uint32_t(phase)];
+}
+
+void BotThread::DrainIoEvents(BotIoChannel& channel)
+{
+    BotIoEvent event;
+    while (channel.PopEvent(event))
+    {
+        DispatchIoEvent(event, false);
     }
 }
 
+void BotThread::DispatchIoEvent(BotIoEvent& event, bool forwarded)
+{
+    auto moved = m_movedConnections.find(event.m_connection);
+    if (moved != m_movedConnections.end())
+    {
+        BotThread* target = moved->second;
+        if (event.m_type != BotIoEvent::PACKET)
+        {
+            // nothing more arrives here for it
+            m_movedConnections.erase(moved);
+        }
+        BotThreadCommand command;
+        command.m_type = BotThreadCommand::Type::IO_EVENT;
+        command.m_ioEvent = std::move(event);
+        target->PushCommand(std::move(command));
+        return;
+    }
+
+    auto held = m_heldIoEvents.find(event.m_connection);
+    if (held != m_heldIoEvents.end())
+    {
+        if (!forwarded)
+        {
+            held->second.push_back(std::move(event));
+            return;
+        }
+        if (event.m_type != BotIoEvent::PACKET)
+        {
+            // the old thread passed on everything it had, the events that waited here are next
+            std::vector<BotIoEvent> events = std::move(held->second);
+            m_heldIoEvents.erase(held);
+            for (BotIoEvent& next : events)
+            {
+                DispatchIoEvent(next, false);
+            }
+        }
+    }
+
+    auto itr = m_pipelinedBots.find(event.m_connection);
+    if (itr != m_pipelinedBots.end())
+    {
+        Bot* bot = itr->second;
+        if (event.m_type == BotIoEvent::CLOSED)
+        {
+            m_pipelinedBots.erase(itr);
+            bot->GetWorldSocket2().OnIoClosed();
+        }
+        else if (event.m_type == BotIoEvent::PACKET)
+        {
+            bot->OnWorldRead();
+            WorldPacket packet(event.m_packet.data(), event.m_packet.size());
+            bot->HandleWorldPacket(packet);
+        }
+    }
+    else if (!forwarded)
+    {
+        // the bot moved here and its ADOPT runs with the next commands
+        m_earlyIoEvents[event.m_connection].push_back(std::move(event));
+        return;
+    }
+    BotBufferPool::ReleaseBuffer(std::move(event.m_packet));
+}
+
+BotThreadCommand::BotThreadCommand() = default;
+BotThreadCommand::BotThreadCommand(BotThreadCommand&&) = default;
+BotThreadCommand& BotThreadCommand::operator=(BotThreadCommand&&) = default;
+BotThreadCommand::~BotThreadCommand() = default;
+
 BotThread::~BotThread()
 {
     // force reset callbacks before we clear the lua state
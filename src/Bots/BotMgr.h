@@ -17,6 +17,14 @@
 #pragma once
 
 #include "BotSocket.h"
+#include "BotBufferPool.h"
+#include "BotArc4.h"
+#include "BotTimerWheel.h"
+#include "BotWarmPool.h"
+#include "BotMpscQueue.h"
+#include "BotSlotTable.h"
+#include "BotIoThread.h"
+#include "BotLuaValue.h"
 #include "BotConfig.h"
 #include "BotMain.h"
 
@@ -26,16 +34,65 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <mutex>
 #include <memory>
 #include <optional>
 #include <atomic>
+#include <array>
+#include <deque>
+#include <random>
 
 class Bot;
+class BotThread;
+enum class BotTimeoutPhase : uint8_t;
+class BotIoChannel;
+class BotIoThread;
 class BotProfile;
 class BotProfileLua;
 class BotProfileMgr;
 
+// Work other threads hand to a BotThread, executed at the start of its next tick
+struct BotThreadCommand
+{
+    enum class Type : uint8_t
+    {
+        LOGIN,
+        LOGOUT,
+        RELOAD,
+        // releases a bot to m_target, which receives it as ADOPT
+        MIGRATE,
+        ADOPT,
+        // an io event the old thread of a moved bot passes on
+        IO_EVENT
+    };
+    Type m_type = Type::RELOAD;
+    std::string m_username;
+    // LOGIN
+    std::string m_password;
+    std::string m_events;
+    std::string m_authserver;
+    // steady clock ms when StartBot queued the login
+    uint64_t m_queuedTime = 0;
+    // MIGRATE
+    BotThread* m_target = nullptr;
+    // ADOPT, m_login is whether the bot should be logged in again
+    std::unique_ptr<Bot> m_bot;
+    bool m_login = false;
+    // ADOPT of a bot that kept its connections
+    bool m_live = false;
+    std::optional<BotSocketHandle> m_authHandle;
+    std::optional<BotSocketHandle> m_worldHandle;
+    std::optional<BotArc4Engine::State> m_encrypt;
+    std::optional<BotLuaValue> m_data;
+    // IO_EVENT
+    BotIoEvent m_ioEvent;
+    BotThreadCommand();
+    BotThreadCommand(BotThreadCommand&&);
+    BotThreadCommand& operator=(BotThreadCommand&&);
+    ~BotThreadCommand();
+};
+
 class BotThread
 {
 public:
@@ -45,15 +102,74 @@ public:
     std::unique_ptr<BotProfileMgr> m_events = nullptr;
     std::unique_ptr<BotProfileLua> m_lua = nullptr;
     boost::asio::io_context m_context;
+    BotBufferPool m_bufferPool;
+    // Outbound world packet headers of this thread's bots
+    BotArc4Engine m_arc4;
+    // Dispatches packets the io thread framed for this thread's bots
+    void DrainIoEvents(BotIoChannel& channel);
+    // Timeout in ms for a phase, 0 if disabled
+    uint32_t GetTimeout(BotTimeoutPhase phase) const;
+    // ns, for the tick cost the balancer works with
+    static uint64_t GetCostClock();
+    // Moving average of the ns a tick and the packets handled since the last one took
+    uint64_t GetTickCost() const;
+    // All timers of this thread, advanced every tick
+    BotTimerWheel m_timers;
+    // Auth connections opened ahead of queued logins
+    BotWarmPool m_warmPool;
     ~BotThread();
 private:
     void run();
+    // Any thread
+    void PushCommand(BotThreadCommand&& command);
+    void ExecuteCommands();
+    void OnLogin(BotThreadCommand& command);
+    void OnLogout(BotThreadCommand& command);
+    void OnReload();
+    void OnMigrate(BotThreadCommand& command);
+    void OnAdopt(BotThreadCommand& command);
+    // Live if the bot can keep its connections (see Bot::CanMigrateLive), otherwise it logs in again
+    void StartMigration(Bot* bot, BotThread* target);
+    // Hands a bot that has nothing in flight to "target"
+    void ReleaseBot(Bot* bot, BotThread* target, bool live);
+    // Moves the most expensive bots to the cheapest thread if this one runs clearly hotter
+    void Balance();
+    void DispatchIoEvent(BotIoEvent& event, bool forwarded);
+    // Puts a bot of this thread at the back of the login queue
+    void QueueLogin(BotId id);
     uint32_t m_threadId;
-    std::vector<std::string> m_queuedLogins;
-    std::vector<std::string> m_queuedRemoves;
-    std::map<std::string, Bot*> m_botsWithAI;
-    int m_bot_count = 0;
-    std::atomic<bool> m_shouldReload = true;
+    BotMpscQueue<BotThreadCommand> m_commands;
+    // the bots of this thread, only touched by it
+    BotSlotTable m_bots;
+    // bots that migrated away, commands that still arrive here are passed on
+    std::map<std::string, BotThread*> m_migratedBots;
+    // queued logins waiting for the login ramp to admit them
+    std::deque<BotId> m_pendingLogins;
+    // bots whose world connection lives on an io thread, by connection id
+    std::unordered_map<uint64_t, Bot*> m_pipelinedBots;
+    // connections of bots that moved away, their events are passed on until the io thread reports the move
+    std::unordered_map<uint64_t, BotThread*> m_movedConnections;
+    // connections of bots that moved here, their events wait for the ones the old thread passes on
+    std::unordered_map<uint64_t, std::vector<BotIoEvent>> m_heldIoEvents;
+    // events of connections whose ADOPT is still in the inbox, dropped if none was
+    std::unordered_map<uint64_t, std::vector<BotIoEvent>> m_earlyIoEvents;
+    std::atomic<uint64_t> m_tickCost = 0;
+    // ns spent on packets since the last tick
+    uint64_t m_packetCost = 0;
+    uint64_t m_nextBalance = 0;
+    // bots BotMgr assigned to this thread
+    std::atomic<int> m_bot_count = 0;
+    std::array<uint32_t, 4> m_timeouts = {};
+    bool m_requeueOnTimeout = false;
+    bool m_authReconnect = true;
+    // Bots.Balance*, costs in ns
+    uint32_t m_balanceInterval = 0;
+    float m_balanceThreshold = 0;
+    uint64_t m_balanceMinCost = 0;
+    uint32_t m_balanceMaxBots = 0;
+    uint32_t m_balanceTicks = 0;
+    // reconnect jitter
+    std::minstd_rand m_random;
     boost::asio::deadline_timer m_timer;
     friend class Bot;
     friend class BotMgr;
@@ -63,14 +179,33 @@ class BotMgr
 {
 public:
     static BotMgr* instance();
+    BotMgr();
+    ~BotMgr();
     void StartBot(std::string const& username, std::string const& password, std::string const& events, std::string const& authserver);
     void StopBot(std::string const& username);
+    // Moves a bot to another BotThread, see BotThread::StartMigration
+    void MigrateBot(std::string const& username, uint32_t thread);
     void Initialize();
     void Reload();
+    void LogStats();
+    // Whether world connections are run on io threads (Bots.IoThreadCount > 0)
+    bool IsPipelined() const;
+    BotIoChannel& GetIoChannel(BotThread& logic, uint64_t connection);
     std::mutex m_botMutex;
 private:
-    std::map<std::string, std::unique_ptr<Bot>> m_bots;
+    // Which thread runs a bot. Kept after logout, so a bot logs in on the thread
+    // that still handles its logout and the two commands stay in order.
+    struct BotEntry
+    {
+        BotThread* m_thread;
+        bool m_active;
+    };
+    // Called by the thread that adopted a migrated bot
+    void OnBotMigrated(std::string const& username, BotThread* thread);
+    // guarded by m_botMutex, the bot threads never look at it
+    std::unordered_map<std::string, BotEntry> m_bots;
     std::vector<std::unique_ptr<BotThread>> m_threads;
+    std::vector<std::unique_ptr<BotIoThread>> m_ioThreads;
     friend class BotThread;
 };
 
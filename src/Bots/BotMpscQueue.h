@@ -0,0 +1,82 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free queue for any number of producer threads and one consumer.
+// Producers only swap the head pointer, so a push never waits for another thread.
+// A push is visible to the consumer once it linked its node, until then Pop may
+// report the queue as empty.
+template <typename T>
+class BotMpscQueue
+{
+public:
+    BotMpscQueue()
+        : m_head(new Node())
+    {
+        m_tail = m_head.load(std::memory_order_relaxed);
+    }
+
+    BotMpscQueue(BotMpscQueue const&) = delete;
+    BotMpscQueue& operator=(BotMpscQueue const&) = delete;
+
+    ~BotMpscQueue()
+    {
+        while (m_tail)
+        {
+            Node* next = m_tail->m_next.load(std::memory_order_relaxed);
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    // Any thread
+    void Push(T&& value)
+    {
+        Node* node = new Node();
+        node->m_value = std::move(value);
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->m_next.store(node, std::memory_order_release);
+    }
+
+    // Consumer thread only, returns false if the queue is empty
+    bool Pop(T& value)
+    {
+        Node* next = m_tail->m_next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            return false;
+        }
+        // the popped node becomes the new stub
+        value = std::move(next->m_value);
+        delete m_tail;
+        m_tail = next;
+        return true;
+    }
+private:
+    struct Node
+    {
+        T m_value;
+        std::atomic<Node*> m_next = nullptr;
+    };
+    // producer side, the newest node
+    alignas(64) std::atomic<Node*> m_head;
+    // consumer side, the stub in front of the oldest item
+    alignas(64) Node* m_tail;
+};
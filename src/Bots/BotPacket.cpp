@@ -16,17 +16,24 @@
  */
 #include "BotPacket.h"
 #include "Bot.h"
+#include "BotMgr.h"
+#include "BotLogging.h"
+#include "BotBufferPool.h"
 
 #include <promise.hpp>
 
+#include <algorithm>
+
 #define PACKET_WRITE_DEF(type)\
     type& type::WriteString(std::string const& str)\
     {\
+        Detach();\
         m_data.insert(m_data.end(), str.begin(), str.end());\
         return *this;\
     }\
     type& type::WriteCString(std::string const& str)\
     {\
+        Detach();\
         m_data.reserve(m_data.size() + str.size() + 1);\
         WriteString(str);\
         m_data.push_back('\0');\
@@ -42,13 +49,38 @@
     type& type::WriteInt64(int64_t value) { return Write<int64_t>(value);}\
     type& type::WriteFloat(float value) { return Write<float>(value);}\
     type& type::WriteDouble(double value) { return Write<double>(value);}\
-    type& type::WritePadding(uint32_t padding) { m_data.resize(m_data.size() + padding); return *this;}\
+    type& type::WritePadding(uint32_t padding) { Detach(); m_data.resize(m_data.size() + padding); return *this;}\
+
 
+PacketBase::PacketBase()
+{}
 
 PacketBase::PacketBase(std::vector<uint8_t> const& data)
-    : m_data(data)
+    : m_data(BotBufferPool::AcquireBuffer(data.size()))
+{
+    m_data.insert(m_data.end(), data.begin(), data.end());
+}
+
+PacketBase::PacketBase(std::vector<uint8_t>&& data)
+    : m_data(std::move(data))
 {}
 
+PacketBase::~PacketBase()
+{
+    BotBufferPool::ReleaseBuffer(std::move(m_data));
+}
+
+void PacketBase::Detach()
+{
+    if (m_view)
+    {
+        m_data = BotBufferPool::AcquireBuffer(m_viewSize);
+        m_data.insert(m_data.end(), m_view, m_view + m_viewSize);
+        m_view = nullptr;
+        m_viewSize = 0;
+    }
+}
+
 uint8_t PacketBase::ReadUInt8() { return Read<uint8_t>(); }\
 int8_t PacketBase::ReadInt8() { return Read<int8_t>(); }\
 uint16_t PacketBase::ReadUInt16() { return Read<uint16_t>(); }\
@@ -63,88 +95,175 @@ double PacketBase::ReadDouble() { return Read<double>(); }\
 std::vector<uint8_t> PacketBase::ReadBytes(uint32_t size)
 {
     std::vector<uint8_t> bytes(size);
-    memcpy(bytes.data(), m_data.data() + m_read_ctr, size);
+    memcpy(bytes.data(), GetData() + m_read_ctr, size);
     m_read_ctr += size;
     return bytes;
 }
 
+uint8_t const* PacketBase::ReadRaw(uint32_t size)
+{
+    uint8_t const* data = GetData() + m_read_ctr;
+    m_read_ctr += size;
+    return data;
+}
+
 std::string PacketBase::ReadString(uint32_t size)
 {
     std::string str;
     str.resize(size);
-    memcpy(str.data(), m_data.data() + m_read_ctr, size);
+    memcpy(str.data(), GetData() + m_read_ctr, size);
     m_read_ctr += size;
     return str;
 }
 
 std::string PacketBase::ReadCString()
 {
-    std::string str = "";
-    for (int i = 0;; ++i)
-    {
-        char c = m_data[i];
-        if (c == '\0')
-            break;
-        else
-            str.push_back(c);
-    }
-    m_read_ctr += str.size();
+    char const* start = reinterpret_cast<char const*>(GetData() + m_read_ctr);
+    size_t length = strnlen(start, GetSize() - m_read_ctr);
+    std::string str(start, length);
+    m_read_ctr += std::min(length + 1, GetSize() - m_read_ctr);
     return str;
 }
 
 Opcodes WorldPacket::GetOpcode() const
 {
+    if (m_view)
+    {
+        uint16_t opcode;
+        memcpy(&opcode, m_view, sizeof(uint16_t));
+        return Opcodes(opcode);
+    }
     return *reinterpret_cast<Opcodes const*>(m_data.data() + 2);
 }
 
 void WorldPacket::SetOpcode(Opcodes opcode)
 {
+    Detach();
     *reinterpret_cast<Opcodes*>(m_data.data() + 2) = opcode;
 }
 
+// owned packets reserve 2 size and 4 opcode bytes, views start at the 2 opcode bytes
+uint32_t WorldPacket::GetHeaderSize() const
+{
+    return m_view ? 2 : 6;
+}
+
+void WorldPacket::Detach()
+{
+    if (!m_view)
+    {
+        return;
+    }
+    m_data = BotBufferPool::AcquireBuffer(m_viewSize + 4);
+    m_data.resize(m_viewSize + 4);
+    memcpy(m_data.data() + 2, m_view, 2);
+    memcpy(m_data.data() + 6, m_view + 2, m_viewSize - 2);
+    m_read_ctr += 4;
+    m_view = nullptr;
+    m_viewSize = 0;
+}
 
 uint16_t WorldPacket::GetPayloadSize()
 {
-    return m_data.size() - 6;
+    return GetSize() - GetHeaderSize();
 }
 
 void WorldPacket::Reserve(uint32_t amount)
 {
+    Detach();
     m_data.reserve(amount + 6);
 }
 
 void WorldPacket::Reset()
 {
-    m_read_ctr = 6;
+    m_read_ctr = GetHeaderSize();
 }
 void WorldPacket::Seek(uint32_t offset)
 {
-    m_read_ctr = offset + 6;
+    m_read_ctr = offset + GetHeaderSize();
 }
 
 void WorldPacket::Prepare(Bot& bot)
 {
+    Detach();
     uint16_t size = m_data.size() - 2;
     memcpy(m_data.data(), &size, sizeof(uint16_t));
     std::reverse(m_data.begin(), m_data.begin() + 2);
-    if (bot.m_encrypt.has_value())
+    if (bot.m_encryptStream != BotArc4Engine::NONE)
     {
-        bot.m_encrypt->UpdateData(m_data.data(), 6);
+        // encrypted together with the other bots' headers before the thread's sockets write
+        bot.m_thread->m_arc4.Queue(bot.m_encryptStream, m_data.data(), 6);
     }
 }
 
 WorldPacket::WorldPacket(std::vector<uint8_t> const& packet)
-    : PacketBase{ packet }
+    : PacketBase(packet)
 {
     m_read_ctr = 6;
 }
 
+WorldPacket::WorldPacket(uint8_t const* opcodeAndPayload, size_t size)
+    : PacketBase()
+{
+    m_view = opcodeAndPayload;
+    m_viewSize = size;
+    m_read_ctr = 2;
+}
+
+WorldPacket::WorldPacket(WorldPacket const& other)
+    : PacketBase()
+{
+    *this = other;
+}
+
+WorldPacket::WorldPacket(WorldPacket&& other)
+    : PacketBase()
+{
+    *this = std::move(other);
+}
+
+WorldPacket& WorldPacket::operator=(WorldPacket const& other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+    BotBufferPool::ReleaseBuffer(std::move(m_data));
+    m_view = other.m_view;
+    m_viewSize = other.m_viewSize;
+    m_read_ctr = other.m_read_ctr;
+    if (m_view)
+    {
+        // copies never alias the receive buffer
+        Detach();
+    }
+    else
+    {
+        m_data = BotBufferPool::AcquireBuffer(other.m_data.size());
+        m_data.insert(m_data.end(), other.m_data.begin(), other.m_data.end());
+    }
+    return *this;
+}
+
+WorldPacket& WorldPacket::operator=(WorldPacket&& other)
+{
+    if (other.m_view)
+    {
+        return *this = static_cast<WorldPacket const&>(other);
+    }
+    BotBufferPool::ReleaseBuffer(std::move(m_data));
+    m_data = std::move(other.m_data);
+    m_view = nullptr;
+    m_viewSize = 0;
+    m_read_ctr = other.m_read_ctr;
+    return *this;
+}
+
 WorldPacket::WorldPacket(Opcodes opcode, size_t initialSize)
-    : PacketBase({})
+    : PacketBase(BotBufferPool::AcquireBuffer(sizeof(Opcodes) + sizeof(uint16_t) + initialSize))
 {
     m_data.resize(sizeof(Opcodes) + sizeof(uint16_t));
     memcpy(m_data.data() + 2, &opcode, sizeof(Opcodes));
-    m_data.reserve(sizeof(Opcodes) + sizeof(uint16_t) + initialSize);
     m_read_ctr = 6;
 }
 
@@ -152,6 +271,10 @@ AuthPacket::AuthPacket(std::vector<uint8_t> const& packet)
     : PacketBase(packet)
 {}
 
+AuthPacket::AuthPacket(std::vector<uint8_t>&& packet)
+    : PacketBase(std::move(packet))
+{}
+
 void AuthPacket::Reserve(uint32_t amount)
 {
     m_data.reserve(amount);
@@ -168,14 +291,12 @@ void AuthPacket::Seek(uint32_t offset)
 }
 
 AuthPacket::AuthPacket(size_t initialSize)
-    : PacketBase({})
-{
-    Reserve(initialSize);
-}
+    : PacketBase(BotBufferPool::AcquireBuffer(initialSize))
+{}
 
 promise::Promise AuthPacket::Send(Bot& bot)
 {
-    return bot.GetAuthSocket2().WriteVector(m_data);
+    return bot.GetAuthSocket2().QueueWrite(std::move(m_data));
 }
 
 uint64_t WorldPacket::ReadPackedGUID()
@@ -211,55 +332,102 @@ void WorldPacket::WritePackedGUID(uint64_t guid)
     WriteBytes(guidOut);
 }
 
+WorldPacket::FrameResult WorldPacket::FrameWorldPacket(BotReceiveBuffer& buffer, uint32_t& decryptedHeaderBytes, Trinity::Crypto::ARC4* decrypt, uint8_t const*& opcodeAndPayload, size_t& size)
+{
+    uint8_t* data = buffer.GetReadPointer();
+    size_t available = buffer.GetActiveSize();
+
+    // header bytes are decrypted in place exactly once, even if the rest of the packet arrives later
+    auto decryptHeader = [&](uint32_t count) {
+        if (decryptedHeaderBytes < count && decrypt)
+        {
+            decrypt->UpdateData(data + decryptedHeaderBytes, count - decryptedHeaderBytes);
+        }
+        decryptedHeaderBytes = std::max(decryptedHeaderBytes, count);
+    };
+
+    if (available < 2)
+    {
+        return FrameResult::INCOMPLETE;
+    }
+    decryptHeader(2);
+
+    uint32_t sizeBytes = (data[0] & 0x80) ? 3 : 2;
+    if (available < sizeBytes)
+    {
+        return FrameResult::INCOMPLETE;
+    }
+    decryptHeader(sizeBytes);
+
+    uint32_t packetSize = sizeBytes == 3
+        ? (uint32_t)((((data[0]) & 0x7F) << 16) | ((data[1] << 8) | data[2]))
+        : uint32_t((data[0] & 0x7f) << 8 | data[1]);
+
+    if (packetSize < 2)
+    {
+        return FrameResult::MALFORMED;
+    }
+
+    if (available < sizeBytes + 2)
+    {
+        return FrameResult::INCOMPLETE;
+    }
+    decryptHeader(sizeBytes + 2);
+
+    if (available < sizeBytes + packetSize)
+    {
+        return FrameResult::INCOMPLETE;
+    }
+
+    // the data stays valid until the buffer is written to again
+    opcodeAndPayload = data + sizeBytes;
+    size = packetSize;
+    buffer.ReadCompleted(sizeBytes + packetSize);
+    decryptedHeaderBytes = 0;
+    return FrameResult::PACKET;
+}
+
+bool WorldPacket::FrameWorldPacket(Bot& bot, std::optional<WorldPacket>& packet)
+{
+    BotSocket& socket = bot.GetWorldSocket2();
+    uint8_t const* data = nullptr;
+    size_t size = 0;
+    switch (FrameWorldPacket(socket.m_readBuffer, socket.m_decryptedHeaderBytes, bot.m_decrypt.get(), data, size))
+    {
+        case FrameResult::PACKET:
+            // the packet views the receive buffer, which is not touched again until the next read
+            packet.emplace(data, size);
+            return true;
+        case FrameResult::MALFORMED:
+            BOT_LOG_ERROR("WorldPacket", "%s received a world packet without an opcode", bot.GetUsername().c_str());
+            socket.Close();
+            return false;
+        default:
+            return false;
+    }
+}
+
 promise::Promise WorldPacket::ReadWorldPacket(Bot* bot)
 {
-    return bot->GetWorldSocket2()
-        .ReadPOD<std::array<uint8_t,2>>()
-        .then([=](std::array<uint8_t,2> firstBytes){
-            if (bot->m_decrypt.has_value())
-            {
-                bot->m_decrypt->UpdateData(firstBytes.data(), 2);
-            }
-            if (firstBytes[0] & 0x80)
-            {
-                return bot->GetWorldSocket2()
-                    .ReadPOD<uint8_t>()
-                    .then([=](uint8_t extra){
-                        if (bot->m_decrypt.has_value())
-                        {
-                            bot->m_decrypt->UpdateData(&extra, 1);
-                        }
-                        return (uint32_t)((((firstBytes[0]) & 0x7F) << 16) | ((firstBytes[1] << 8) | extra));
-                    })
-                    ;
-            }
-            else
-            {
-                return promise::resolve(uint32_t((firstBytes[0] & 0x7f) << 8 | firstBytes[1]));
-            }
-        })
-        .then([=](uint32_t size) {
-            return bot->GetWorldSocket2()
-                .ReadVector(size)
-                .then([=](std::vector<uint8_t> vec){
-                    if (bot->m_decrypt.has_value())
-                    {
-                        bot->m_decrypt->UpdateData(vec.data(), 2);
-                    }
-                    std::vector<uint8_t> vecFull(vec.size() + 4);
-                    memcpy(vecFull.data() + 2, vec.data(), 2);
-                    memcpy(vecFull.data() + 6, vec.data() + 2, vec.size() - 2);
-                    return WorldPacket(vecFull);
-                })
-                ;
-        })
-        ;
+    return promise::doWhile([=](promise::DeferLoop& loop) {
+        std::optional<WorldPacket> packet;
+        if (FrameWorldPacket(*bot, packet))
+        {
+            return loop.doBreak(packet.value());
+        }
+
+        bot->GetWorldSocket2()
+            .ReadSome()
+            .then([=]() { loop.doContinue(); })
+            .fail([=]() { loop.reject(); })
+            ;
+    });
 }
 
 promise::Promise WorldPacket::Send(Bot& bot)
 {
     Prepare(bot);
-    return bot.GetWorldSocket2().WriteVector(m_data);
+    return bot.GetWorldSocket2().QueueWrite(std::move(m_data));
 }
 
 PACKET_WRITE_DEF(WorldPacket)
@@ -22,17 +22,29 @@
 
 #include <vector>
 #include <string>
+#include <optional>
 
 class Bot;
+class BotReceiveBuffer;
 namespace promise { class Promise; }
+namespace Trinity::Crypto { class ARC4; }
 
 class PacketBase
 {
 protected:
     std::vector<uint8_t> m_data;
+    // Non-owning view over a receive buffer, used instead of m_data while set
+    uint8_t const* m_view = nullptr;
+    size_t m_viewSize = 0;
     uint32_t m_read_ctr = 0;
+    uint8_t const* GetData() const { return m_view ? m_view : m_data.data(); }
+    size_t GetSize() const { return m_view ? m_viewSize : m_data.size(); }
+    // Copies viewed data into m_data so the packet can be written to
+    void Detach();
 public:
     std::vector<uint8_t> ReadBytes(uint32_t size);
+    // Returns a pointer to the next "size" bytes without copying them and moves past them
+    uint8_t const* ReadRaw(uint32_t size);
     std::string ReadString(uint32_t size);
     std::string ReadCString();
 
@@ -51,24 +63,34 @@ public:
     T Read()
     {
         T value;
-        memcpy(&value, m_data.data() + m_read_ctr, sizeof(T));
+        memcpy(&value, GetData() + m_read_ctr, sizeof(T));
         m_read_ctr += sizeof(T);
         return value;
     }
 
+    PacketBase();
     PacketBase(std::vector<uint8_t> const& data);
+    PacketBase(std::vector<uint8_t>&& data);
+    PacketBase(PacketBase const&) = default;
+    PacketBase(PacketBase&&) = default;
+    PacketBase& operator=(PacketBase const&) = default;
+    PacketBase& operator=(PacketBase&&) = default;
+    // hands the storage back to the current BotThreads buffer pool
+    ~PacketBase();
 };
 
 #define PACKET_WRITE_DECL(type)\
     template <typename T>\
     type& WriteBytes(T value)\
     {\
+        Detach();\
         m_data.insert(m_data.end(), value.begin(), value.end());\
         return *this;\
     }\
     template <typename T>\
     type& Write(T value)\
     {\
+        Detach();\
         size_t size = m_data.size();\
         m_data.resize(size + sizeof(T));\
         memcpy(m_data.data() + size, &value, sizeof(T));\
@@ -93,6 +115,13 @@ class WorldPacket: public PacketBase
 public:
     WorldPacket(std::vector<uint8_t> const& packet);
     WorldPacket(Opcodes opcode, size_t initialSize = 0);
+    // Non-owning view over a received opcode followed by its payload.
+    // The viewed memory must outlive the packet, copies of a view own their data.
+    WorldPacket(uint8_t const* opcodeAndPayload, size_t size);
+    WorldPacket(WorldPacket const& other);
+    WorldPacket(WorldPacket&& other);
+    WorldPacket& operator=(WorldPacket const& other);
+    WorldPacket& operator=(WorldPacket&& other);
     uint64_t ReadPackedGUID();
     void WritePackedGUID(uint64_t guid);
     Opcodes GetOpcode() const;
@@ -101,21 +130,38 @@ public:
     void Reserve(uint32_t amount);
     void Reset();
     void Seek(uint32_t offset);
+    // Moves the packet into the world sockets write queue, the packet is empty afterwards
     promise::Promise Send(Bot& bot);
     static promise::Promise ReadWorldPacket(Bot* bot);
+    // Pulls the next complete packet out of the bots world socket receive buffer.
+    // Returns false if the buffer does not hold a complete packet yet.
+    static bool FrameWorldPacket(Bot& bot, std::optional<WorldPacket>& packet);
+    enum class FrameResult
+    {
+        INCOMPLETE,
+        PACKET,
+        MALFORMED
+    };
+    // Framing without a bot, for connections owned by an io thread.
+    // On PACKET "opcodeAndPayload"/"size" point into the buffer until it is written to again.
+    static FrameResult FrameWorldPacket(BotReceiveBuffer& buffer, uint32_t& decryptedHeaderBytes, Trinity::Crypto::ARC4* decrypt, uint8_t const*& opcodeAndPayload, size_t& size);
     PACKET_WRITE_DECL(WorldPacket)
 private:
     void Prepare(Bot& bot);
+    void Detach();
+    uint32_t GetHeaderSize() const;
 };
 
 class AuthPacket: public PacketBase
 {
 public:
     AuthPacket(std::vector<uint8_t> const& packet);
+    AuthPacket(std::vector<uint8_t>&& packet);
     AuthPacket(size_t initialSize = 0);
     void Reserve(uint32_t amount);
     void Reset();
     void Seek(uint32_t offset);
+    // Moves the packet into the auth sockets write queue, the packet is empty afterwards
     promise::Promise Send(Bot& bot);
     PACKET_WRITE_DECL(AuthPacket)
 };
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotReceiveBuffer.h"
+
+#include <cstring>
+
+BotReceiveBuffer::BotReceiveBuffer(size_t initialSize)
+    : m_storage(initialSize)
+{}
+
+uint8_t* BotReceiveBuffer::GetReadPointer()
+{
+    return m_storage.data() + m_rpos;
+}
+
+uint8_t* BotReceiveBuffer::GetWritePointer()
+{
+    return m_storage.data() + m_wpos;
+}
+
+size_t BotReceiveBuffer::GetActiveSize() const
+{
+    return m_wpos - m_rpos;
+}
+
+size_t BotReceiveBuffer::GetRemainingSpace() const
+{
+    return m_storage.size() - m_wpos;
+}
+
+void BotReceiveBuffer::ReadCompleted(size_t bytes)
+{
+    m_rpos += bytes;
+}
+
+void BotReceiveBuffer::WriteCompleted(size_t bytes)
+{
+    m_wpos += bytes;
+}
+
+void BotReceiveBuffer::Normalize()
+{
+    if (m_rpos == 0)
+    {
+        return;
+    }
+
+    if (m_rpos != m_wpos)
+    {
+        memmove(m_storage.data(), m_storage.data() + m_rpos, m_wpos - m_rpos);
+    }
+    m_wpos -= m_rpos;
+    m_rpos = 0;
+}
+
+void BotReceiveBuffer::EnsureFreeSpace(size_t size)
+{
+    if (GetRemainingSpace() >= size)
+    {
+        return;
+    }
+
+    Normalize();
+    if (GetRemainingSpace() < size)
+    {
+        size_t newSize = m_storage.size() > 0 ? m_storage.size() * 2 : size;
+        while (newSize - m_wpos < size)
+        {
+            newSize *= 2;
+        }
+        m_storage.resize(newSize);
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Per-connection receive buffer. Sockets append to the write end with large
+// async_read_some calls and framers consume complete packets from the read end.
+// Leftover bytes are moved back to the front before the next read, so the
+// storage is reused for the whole lifetime of the connection.
+class BotReceiveBuffer
+{
+public:
+    BotReceiveBuffer(size_t initialSize = 4096);
+    uint8_t* GetReadPointer();
+    uint8_t* GetWritePointer();
+    size_t GetActiveSize() const;
+    size_t GetRemainingSpace() const;
+    void ReadCompleted(size_t bytes);
+    void WriteCompleted(size_t bytes);
+    // Moves unread bytes to the start of the storage
+    void Normalize();
+    // Makes sure at least "size" bytes can be written without wrapping
+    void EnsureFreeSpace(size_t size);
+private:
+    std::vector<uint8_t> m_storage;
+    size_t m_rpos = 0;
+    size_t m_wpos = 0;
+};
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotResolver.h"
+
+#include "Config.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using boost::asio::ip::tcp;
+
+BotResolverCache* BotResolverCache::instance()
+{
+    static BotResolverCache cache;
+    return &cache;
+}
+
+void BotResolverCache::Load()
+{
+    std::scoped_lock lock(m_mutex);
+    m_ttl = std::chrono::seconds(std::max(sConfigMgr->GetIntDefault("Network.ResolverCacheTTL", 60), 0));
+    m_entries.clear();
+}
+
+std::optional<BotResolverCache::Results> BotResolverCache::Find(std::string const& host, std::string const& port)
+{
+    boost::system::error_code ec;
+    boost::asio::ip::address address = boost::asio::ip::make_address(host, ec);
+    if (!ec.failed())
+    {
+        char* end = nullptr;
+        unsigned long portNumber = std::strtoul(port.c_str(), &end, 10);
+        if (port.size() > 0 && *end == '\0' && portNumber <= 0xFFFF)
+        {
+            return Results::create(tcp::endpoint(address, uint16_t(portNumber)), host, port);
+        }
+    }
+
+    std::scoped_lock lock(m_mutex);
+    auto itr = m_entries.find({ host, port });
+    if (itr == m_entries.end())
+    {
+        return std::nullopt;
+    }
+    if (itr->second.m_expires <= std::chrono::steady_clock::now())
+    {
+        m_entries.erase(itr);
+        return std::nullopt;
+    }
+    return itr->second.m_results;
+}
+
+void BotResolverCache::Store(std::string const& host, std::string const& port, Results const& results)
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_ttl.count() == 0)
+    {
+        return;
+    }
+    m_entries[{ host, port }] = { results, std::chrono::steady_clock::now() + m_ttl };
+}
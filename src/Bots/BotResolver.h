@@ -0,0 +1,49 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+// Process-wide cache of resolved auth/world endpoints shared by all BotThreads.
+// Numeric addresses never reach the resolver, names are cached for Network.ResolverCacheTTL seconds.
+class BotResolverCache
+{
+public:
+    using Results = boost::asio::ip::tcp::resolver::results_type;
+    static BotResolverCache* instance();
+    void Load();
+    std::optional<Results> Find(std::string const& host, std::string const& port);
+    void Store(std::string const& host, std::string const& port, Results const& results);
+private:
+    struct Entry
+    {
+        Results m_results;
+        std::chrono::steady_clock::time_point m_expires;
+    };
+    std::mutex m_mutex;
+    std::map<std::pair<std::string, std::string>, Entry> m_entries;
+    std::chrono::seconds m_ttl = std::chrono::seconds(60);
+};
+
+#define sBotResolverCache BotResolverCache::instance()
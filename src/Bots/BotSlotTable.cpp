@@ -0,0 +1,153 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotSlotTable.h"
+#include "Bot.h"
+#include "BehaviorTree.h"
+
+BotSlotTable::BotSlotTable() = default;
+BotSlotTable::~BotSlotTable() = default;
+
+BotId BotSlotTable::Insert(std::unique_ptr<Bot> bot)
+{
+    uint32_t index;
+    if (m_freeSlots.size() > 0)
+    {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        index = uint32_t(m_slots.size());
+        m_slots.emplace_back();
+    }
+
+    Slot& slot = m_slots[index];
+    BotId id = { index, slot.m_generation };
+    slot.m_dense = uint32_t(m_dense.size());
+    m_dense.push_back(bot.get());
+    m_denseSlots.push_back(index);
+    m_names[bot->GetUsername()] = id;
+    bot->m_id = id;
+    slot.m_bot = std::move(bot);
+    if (slot.m_bot->m_behavior)
+    {
+        AddBehavior(index);
+    }
+    return id;
+}
+
+std::unique_ptr<Bot> BotSlotTable::Remove(BotId id)
+{
+    if (!Get(id))
+    {
+        return nullptr;
+    }
+    RemoveBehavior(id.m_index);
+    Slot& slot = m_slots[id.m_index];
+    std::unique_ptr<Bot> bot = std::move(slot.m_bot);
+    m_names.erase(bot->GetUsername());
+    bot->m_id = BotId();
+
+    // the last bot takes the removed one's place
+    uint32_t dense = slot.m_dense;
+    m_dense[dense] = m_dense.back();
+    m_denseSlots[dense] = m_denseSlots.back();
+    m_slots[m_denseSlots[dense]].m_dense = dense;
+    m_dense.pop_back();
+    m_denseSlots.pop_back();
+
+    slot.m_generation++;
+    m_freeSlots.push_back(id.m_index);
+    return bot;
+}
+
+Bot* BotSlotTable::Get(BotId id) const
+{
+    if (id.m_index >= m_slots.size())
+    {
+        return nullptr;
+    }
+    Slot const& slot = m_slots[id.m_index];
+    return slot.m_generation == id.m_generation ? slot.m_bot.get() : nullptr;
+}
+
+Bot* BotSlotTable::Find(std::string const& username) const
+{
+    auto itr = m_names.find(username);
+    return itr != m_names.end() ? Get(itr->second) : nullptr;
+}
+
+std::vector<Bot*> const& BotSlotTable::GetBots() const
+{
+    return m_dense;
+}
+
+std::vector<Bot*> const& BotSlotTable::GetBehaviorBots() const
+{
+    return m_behaviorBots;
+}
+
+void BotSlotTable::UpdateBehavior(BotId id)
+{
+    Bot* bot = Get(id);
+    if (!bot)
+    {
+        return;
+    }
+    if (bot->m_behavior)
+    {
+        AddBehavior(id.m_index);
+    }
+    else
+    {
+        RemoveBehavior(id.m_index);
+    }
+}
+
+void BotSlotTable::AddBehavior(uint32_t index)
+{
+    Slot& slot = m_slots[index];
+    if (slot.m_behavior != UINT32_MAX)
+    {
+        return;
+    }
+    slot.m_behavior = uint32_t(m_behaviorBots.size());
+    m_behaviorBots.push_back(slot.m_bot.get());
+    m_behaviorSlots.push_back(index);
+}
+
+void BotSlotTable::RemoveBehavior(uint32_t index)
+{
+    Slot& slot = m_slots[index];
+    uint32_t behavior = slot.m_behavior;
+    if (behavior == UINT32_MAX)
+    {
+        return;
+    }
+    // same swap with the last entry as for m_dense
+    m_behaviorBots[behavior] = m_behaviorBots.back();
+    m_behaviorSlots[behavior] = m_behaviorSlots.back();
+    m_slots[m_behaviorSlots[behavior]].m_behavior = behavior;
+    m_behaviorBots.pop_back();
+    m_behaviorSlots.pop_back();
+    slot.m_behavior = UINT32_MAX;
+}
+
+size_t BotSlotTable::GetSize() const
+{
+    return m_dense.size();
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Bot;
+
+// Identifies a bot on its thread. A slot gets a new generation whenever it is reused,
+// so an id left in a queue or timer stops finding a bot once that bot is gone.
+struct BotId
+{
+    uint32_t m_index = UINT32_MAX;
+    uint32_t m_generation = 0;
+    bool IsValid() const { return m_index != UINT32_MAX; }
+    bool operator==(BotId const& other) const { return m_index == other.m_index && m_generation == other.m_generation; }
+    bool operator!=(BotId const& other) const { return !(*this == other); }
+};
+
+// The bots of one BotThread. Besides the slots (for BotId lookups) the bots are kept
+// packed in one array, and those with a behavior tree in a second one, so a tick only
+// walks the bots it updates. Usernames are only a secondary index.
+class BotSlotTable
+{
+public:
+    BotSlotTable();
+    ~BotSlotTable();
+    BotId Insert(std::unique_ptr<Bot> bot);
+    // Takes the bot out of the table, null for a stale id
+    std::unique_ptr<Bot> Remove(BotId id);
+    // Null for a stale id
+    Bot* Get(BotId id) const;
+    Bot* Find(std::string const& username) const;
+    // Every bot in the table, in no particular order. Insert and Remove invalidate it.
+    std::vector<Bot*> const& GetBots() const;
+    // The bots that have a behavior tree, in no particular order
+    std::vector<Bot*> const& GetBehaviorBots() const;
+    // Call after the bot's behavior tree was set or cleared
+    void UpdateBehavior(BotId id);
+    size_t GetSize() const;
+private:
+    struct Slot
+    {
+        std::unique_ptr<Bot> m_bot;
+        uint32_t m_generation = 0;
+        // position in m_dense
+        uint32_t m_dense = 0;
+        // position in m_behaviorBots, UINT32_MAX without a behavior tree
+        uint32_t m_behavior = UINT32_MAX;
+    };
+    void AddBehavior(uint32_t index);
+    void RemoveBehavior(uint32_t index);
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<Bot*> m_dense;
+    // slot of each m_dense entry, to fix up the one moved by a removal
+    std::vector<uint32_t> m_denseSlots;
+    std::vector<Bot*> m_behaviorBots;
+    std::vector<uint32_t> m_behaviorSlots;
+    std::unordered_map<std::string, BotId> m_names;
+};
@@ -15,126 +15,607 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "BotSocket.h"
+#include "BotBufferPool.h"
+#include "BotArc4.h"
+#include "BotSourceAddresses.h"
+#include "BotResolver.h"
+#include "BotIoThread.h"
+#include "BotTimerWheel.h"
+#include "BotLogging.h"
+
 #include <promise.hpp>
 
+#include <algorithm>
+
 using boost::asio::ip::tcp;
 
 BotSocket::BotSocket(boost::asio::io_context& ctx)
-    : m_socket(ctx)
+    : m_lifetime(std::make_shared<bool>(true))
+    , m_socket(ctx)
     , m_resolver(ctx)
 {
 }
 
-void BotSocket::Close()
+BotReceiveBuffer& BotSocket::GetReadBuffer()
 {
-    m_socket.close();
+    return m_readBuffer;
 }
 
-promise::Promise BotSocket::Connect(std::string const& address, std::string const& port)
+static constexpr size_t MIN_READ_SIZE = 4096;
+
+promise::Promise BotSocket::ReadSome()
 {
-    return promise::newPromise([this, address, port](promise::Defer& defer) {
-        m_resolver.async_resolve(address, port, [this, defer](const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::results_type results) {
-            if (ec.failed())
+    return promise::newPromise([this](promise::Defer& defer) {
+        if (m_readCancelled)
+        {
+            return defer.reject();
+        }
+        m_reading = true;
+        uint64_t delay = m_impairment ? GetReadDelay() : 0;
+        if (delay == 0)
+        {
+            return StartRead(defer);
+        }
+        std::weak_ptr<bool> lifetime = m_lifetime;
+        m_timers->Schedule(delay, [this, lifetime, defer]() {
+            if (lifetime.expired())
             {
-                defer.reject();
+                return defer.reject();
             }
-            else
+            if (m_readCancelled)
             {
-                boost::asio::async_connect(m_socket, results, [defer](const boost::system::error_code& ec, auto _) {
-                    if (ec.failed())
-                    {
-                        return defer.reject();
-                    }
-                    else
-                    {
-                        return defer.resolve();
-                    }
-                    });
+                m_reading = false;
+                return defer.reject();
             }
+            StartRead(defer);
         });
     });
 }
 
-promise::Promise BotSocket::ReadVector(uint32_t size)
+void BotSocket::StartRead(promise::Defer defer)
+{
+    m_readBuffer.Normalize();
+    m_readBuffer.EnsureFreeSpace(MIN_READ_SIZE);
+    std::weak_ptr<bool> lifetime = m_lifetime;
+    m_socket.async_read_some(boost::asio::buffer(m_readBuffer.GetWritePointer(), m_readBuffer.GetRemainingSpace()), [this, lifetime, defer](const boost::system::error_code& ec, std::size_t len) {
+        if (lifetime.expired())
+        {
+            return defer.reject();
+        }
+        m_reading = false;
+        if (ec.failed())
+        {
+            return defer.reject();
+        }
+        m_readBuffer.WriteCompleted(len);
+        OnImpairedRead(len);
+        return defer.resolve();
+    });
+}
+
+BotImpairment BotImpairment::Create(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime)
+{
+    BotImpairment impairment;
+    impairment.m_latency = latency;
+    impairment.m_jitter = jitter;
+    impairment.m_bandwidth = bandwidth;
+    impairment.m_stallChance = std::clamp(stallChance, 0.0f, 1.0f);
+    impairment.m_stallTime = stallTime;
+    return impairment;
+}
+
+void BotSocket::SetImpairment(BotImpairment const& impairment, BotTimerWheel& timers, std::minstd_rand& random)
+{
+    m_impairment = impairment;
+    m_timers = &timers;
+    m_random = &random;
+}
+
+void BotSocket::ClearImpairment()
+{
+    // QueueWrite keeps delaying until the writes that already wait went out, so they stay in order
+    m_impairment.reset();
+    m_readResumeTime = 0;
+}
+
+bool BotSocket::RollStall()
+{
+    return m_impairment->m_stallChance > 0.0f
+        && std::uniform_real_distribution<float>(0.0f, 1.0f)(*m_random) < m_impairment->m_stallChance;
+}
+
+uint64_t BotSocket::GetReadDelay()
+{
+    uint64_t now = m_timers->GetTime();
+    uint64_t delay = m_readResumeTime > now ? m_readResumeTime - now : 0;
+    if (RollStall())
+    {
+        delay += m_impairment->m_stallTime;
+    }
+    return delay;
+}
+
+void BotSocket::OnImpairedRead(size_t size)
 {
-    std::vector<uint8_t>* vec = new std::vector<uint8_t>(size);
-    return promise::newPromise([=](promise::Defer& defer) {
-        boost::asio::async_read(m_socket, boost::asio::buffer(vec->data(), vec->size()), [vec,size,defer](const boost::system::error_code& ec, auto _) {
-            std::vector<uint8_t> vecValue(size);
-            memcpy(vecValue.data(), vec->data(), vec->size());
-            delete vec;
+    if (m_impairment && m_impairment->m_bandwidth > 0)
+    {
+        // the next read waits until this one would have trickled in
+        m_readResumeTime = std::max(m_readResumeTime, m_timers->GetTime()) + uint64_t(size) * 1000 / m_impairment->m_bandwidth;
+    }
+}
+
+void BotSocket::Close()
+{
+    if (m_ioChannel)
+    {
+        if (!m_ioClosed)
+        {
+            m_ioChannel->Close(m_ioConnection);
+            m_ioClosed = true;
+        }
+        return;
+    }
+    m_socket.close();
+}
+
+bool BotSocket::IsOpen() const
+{
+    return m_ioChannel ? !m_ioClosed : m_socket.is_open();
+}
+
+bool BotSocket::IsIdle() const
+{
+    return !m_writing && !m_flushScheduled && m_writeQueue.empty() && m_delayedWrites == 0;
+}
+
+bool BotSocket::IsReading() const
+{
+    return m_reading;
+}
+
+void BotSocket::CancelRead()
+{
+    m_readCancelled = true;
+    boost::system::error_code ec;
+    m_socket.cancel(ec);
+}
+
+std::weak_ptr<bool> BotSocket::GetLifetime() const
+{
+    return m_lifetime;
+}
+
+void BotSocket::HandOff(BotIoChannel& channel, uint64_t connection, std::unique_ptr<Trinity::Crypto::ARC4> decrypt)
+{
+    BotIoCommand command;
+    command.m_type = BotIoCommand::ADOPT;
+    command.m_connection = connection;
+    boost::system::error_code ec;
+    command.m_v6 = m_socket.local_endpoint(ec).address().is_v6();
+    command.m_buffer.assign(m_readBuffer.GetReadPointer(), m_readBuffer.GetReadPointer() + m_readBuffer.GetActiveSize());
+    command.m_decryptedHeaderBytes = m_decryptedHeaderBytes;
+    m_decryptedHeaderBytes = 0;
+    command.m_decrypt = std::move(decrypt);
+    command.m_handle = m_socket.release();
+    m_readBuffer.ReadCompleted(m_readBuffer.GetActiveSize());
+    m_ioChannel = &channel;
+    m_ioConnection = connection;
+    channel.Push(std::move(command));
+}
+
+uint64_t BotSocket::GetIoConnection() const
+{
+    return m_ioConnection;
+}
+
+void BotSocket::OnIoClosed()
+{
+    m_ioClosed = true;
+}
+
+std::optional<BotSocketHandle> BotSocket::Release()
+{
+    // anything still queued on the old io_context finds the socket gone
+    m_lifetime = std::make_shared<bool>(true);
+    m_impairment.reset();
+    m_timers = nullptr;
+    m_random = nullptr;
+    if (m_ioChannel || !m_socket.is_open())
+    {
+        return std::nullopt;
+    }
+    BotSocketHandle handle;
+    boost::system::error_code ec;
+    handle.m_v6 = m_socket.local_endpoint(ec).address().is_v6();
+    handle.m_handle = m_socket.release();
+    return handle;
+}
+
+void BotSocket::Rebind(boost::asio::io_context& ctx, std::optional<BotSocketHandle> const& handle)
+{
+    m_socket = boost::asio::ip::tcp::socket(ctx);
+    m_resolver = boost::asio::ip::tcp::resolver(ctx);
+    m_reading = false;
+    m_readCancelled = false;
+    if (handle.has_value())
+    {
+        boost::system::error_code ec;
+        m_socket.assign(handle->m_v6 ? boost::asio::ip::tcp::v6() : boost::asio::ip::tcp::v4(), handle->m_handle, ec);
+        if (ec.failed())
+        {
+            BOT_LOG_ERROR("network", "Failed to move socket to another thread: %s", ec.message().c_str());
+        }
+    }
+}
+
+BotIoChannel* BotSocket::MoveIo(BotIoChannel& channel, uint32_t logicThread, BotIoCommand& move)
+{
+    BotIoChannel* old = m_ioClosed ? nullptr : m_ioChannel;
+    move.m_type = BotIoCommand::MOVE;
+    move.m_connection = m_ioConnection;
+    move.m_logicThread = logicThread;
+    m_ioChannel = &channel;
+    return old;
+}
+
+std::optional<tcp::endpoint> BotSocket::BindSource(tcp::resolver::results_type const& results, uint64_t sourceHint, boost::system::error_code& ec)
+{
+    std::optional<boost::asio::ip::address> source = sBotSourceAddressPool->Select(sourceHint);
+    if (!source)
+    {
+        return std::nullopt;
+    }
+
+    for (tcp::endpoint const& endpoint : results)
+    {
+        if (endpoint.address().is_v4() != source->is_v4())
+        {
+            continue;
+        }
+        m_socket.open(endpoint.protocol(), ec);
+        if (ec.failed())
+        {
+            return std::nullopt;
+        }
+#ifdef IP_BIND_ADDRESS_NO_PORT
+        // let connect pick the port, so ports are only unique per destination
+        m_socket.set_option(boost::asio::detail::socket_option::boolean<IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT>(true), ec);
+#endif
+        m_socket.bind(tcp::endpoint(source.value(), 0), ec);
+        if (ec.failed())
+        {
+            BOT_LOG_ERROR("network", "Failed to bind source address %s: %s", source->to_string().c_str(), ec.message().c_str());
+            return std::nullopt;
+        }
+        return endpoint;
+    }
+
+    ec = boost::asio::error::address_family_not_supported;
+    BOT_LOG_ERROR("network", "No endpoint matches the address family of source address %s", source->to_string().c_str());
+    return std::nullopt;
+}
+
+promise::Promise BotSocket::Connect(std::string const& address, std::string const& port, uint64_t sourceHint)
+{
+    return promise::newPromise([this, address, port, sourceHint](promise::Defer& defer) {
+        if (std::optional<tcp::resolver::results_type> cached = sBotResolverCache->Find(address, port))
+        {
+            return ConnectResolved(cached.value(), sourceHint, defer);
+        }
+        m_resolver.async_resolve(address, port, [this, address, port, defer, sourceHint](const boost::system::error_code& ec, tcp::resolver::results_type results) {
             if (ec.failed())
             {
                 return defer.reject();
             }
-            else
-            {
-                return defer.resolve(vecValue);
-            }
+            sBotResolverCache->Store(address, port, results);
+            ConnectResolved(results, sourceHint, defer);
         });
     });
 }
 
+void BotSocket::ConnectResolved(tcp::resolver::results_type const& results, uint64_t sourceHint, promise::Defer defer)
+{
+    auto onConnect = [defer](const boost::system::error_code& ec, auto&&...) {
+        if (ec.failed())
+        {
+            return defer.reject();
+        }
+        else
+        {
+            return defer.resolve();
+        }
+    };
+
+    boost::system::error_code bindError;
+    std::optional<tcp::endpoint> endpoint = BindSource(results, sourceHint, bindError);
+    if (bindError.failed())
+    {
+        return defer.reject();
+    }
+    if (endpoint)
+    {
+        // async_connect over a range reopens the socket for every endpoint, which drops the bind
+        m_socket.async_connect(endpoint.value(), onConnect);
+    }
+    else
+    {
+        boost::asio::async_connect(m_socket, results, onConnect);
+    }
+}
+
+#ifdef BOTS_AUTH_COROUTINES
+boost::asio::awaitable<void> BotSocket::ConnectAsync(std::string const& address, std::string const& port, uint64_t sourceHint)
+{
+    std::optional<tcp::resolver::results_type> cached = sBotResolverCache->Find(address, port);
+    tcp::resolver::results_type results;
+    if (cached)
+    {
+        results = cached.value();
+    }
+    else
+    {
+        results = co_await m_resolver.async_resolve(address, port, boost::asio::use_awaitable);
+        sBotResolverCache->Store(address, port, results);
+    }
+    boost::system::error_code ec;
+    std::optional<tcp::endpoint> endpoint = BindSource(results, sourceHint, ec);
+    if (ec.failed())
+    {
+        throw boost::system::system_error(ec);
+    }
+    if (endpoint)
+    {
+        co_await m_socket.async_connect(endpoint.value(), boost::asio::use_awaitable);
+    }
+    else
+    {
+        co_await boost::asio::async_connect(m_socket, results, boost::asio::use_awaitable);
+    }
+}
+
+boost::asio::awaitable<void> BotSocket::ReadSomeAsync()
+{
+    std::weak_ptr<bool> lifetime = m_lifetime;
+    if (uint64_t delay = m_impairment ? GetReadDelay() : 0)
+    {
+        boost::asio::steady_timer timer(m_socket.get_executor(), std::chrono::milliseconds(delay));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        if (lifetime.expired())
+        {
+            throw boost::system::system_error(boost::asio::error::operation_aborted);
+        }
+    }
+    m_readBuffer.Normalize();
+    m_readBuffer.EnsureFreeSpace(MIN_READ_SIZE);
+    size_t len = co_await m_socket.async_read_some(boost::asio::buffer(m_readBuffer.GetWritePointer(), m_readBuffer.GetRemainingSpace()), boost::asio::use_awaitable);
+    if (lifetime.expired())
+    {
+        throw boost::system::system_error(boost::asio::error::operation_aborted);
+    }
+    m_readBuffer.WriteCompleted(len);
+    OnImpairedRead(len);
+}
+
+boost::asio::awaitable<void> BotSocket::FillAsync(size_t size)
+{
+    while (m_readBuffer.GetActiveSize() < size)
+    {
+        co_await ReadSomeAsync();
+    }
+}
+
+boost::asio::awaitable<std::string> BotSocket::ReadCStringAsync()
+{
+    size_t scanned = 0;
+    for (;;)
+    {
+        char const* start = reinterpret_cast<char const*>(m_readBuffer.GetReadPointer());
+        void const* end = memchr(start + scanned, 0, m_readBuffer.GetActiveSize() - scanned);
+        if (end)
+        {
+            std::string value(start, static_cast<char const*>(end));
+            m_readBuffer.ReadCompleted(value.size() + 1);
+            co_return value;
+        }
+        scanned = m_readBuffer.GetActiveSize();
+        co_await ReadSomeAsync();
+    }
+}
+#endif
+
+promise::Promise BotSocket::Fill(size_t size)
+{
+    if (m_readBuffer.GetActiveSize() >= size)
+    {
+        return promise::resolve();
+    }
+    return promise::doWhile([this, size](promise::DeferLoop& loop) {
+        if (m_readBuffer.GetActiveSize() >= size)
+        {
+            return loop.doBreak();
+        }
+        ReadSome()
+            .then([=]() { loop.doContinue(); })
+            .fail([=]() { loop.reject(); });
+    });
+}
+
+promise::Promise BotSocket::ReadVector(uint32_t size)
+{
+    return Fill(size).then([this, size]() {
+        uint8_t const* data = m_readBuffer.GetReadPointer();
+        std::vector<uint8_t> value(data, data + size);
+        m_readBuffer.ReadCompleted(size);
+        return promise::resolve(value);
+    });
+}
 
 promise::Promise BotSocket::WriteVector(std::vector<uint8_t> const& value)
 {
-    uint8_t* arr = new uint8_t[value.size()];
-    memcpy(arr, value.data(), value.size());
-    size_t size = value.size();
-    return promise::newPromise([=](promise::Defer& defer) {
-        boost::asio::async_write(m_socket, boost::asio::buffer(arr,size), [=](const boost::system::error_code& ec, auto _) {
-            delete[] arr;
-            if (ec.failed())
-            {
-                defer.reject(ec);
-            }
-            else
+    return QueueWrite(std::vector<uint8_t>(value));
+}
+
+promise::Promise BotSocket::QueueWrite(std::vector<uint8_t>&& buffer)
+{
+    // world headers are encrypted in send order, so nothing may overtake a delayed write
+    if (m_impairment || m_delayedWrites > 0)
+    {
+        return QueueImpairedWrite(std::move(buffer));
+    }
+    return QueueWriteNow(std::move(buffer));
+}
+
+promise::Promise BotSocket::QueueImpairedWrite(std::vector<uint8_t>&& buffer)
+{
+    uint64_t now = m_timers->GetTime();
+    uint64_t release = now;
+    // without an impairment (it was cleared) the write only waits for the delayed ones
+    if (m_impairment)
+    {
+        BotImpairment const& impairment = m_impairment.value();
+        release += impairment.m_latency;
+        if (impairment.m_jitter > 0)
+        {
+            release += std::uniform_int_distribution<uint32_t>(0, impairment.m_jitter)(*m_random);
+        }
+        if (RollStall())
+        {
+            release += impairment.m_stallTime;
+        }
+    }
+    // tcp does not reorder, a write never overtakes the one before it
+    release = std::max(release, m_writeReleaseTime);
+    m_writeReleaseTime = release;
+    if (m_impairment && m_impairment->m_bandwidth > 0)
+    {
+        m_writeReleaseTime += uint64_t(buffer.size()) * 1000 / m_impairment->m_bandwidth;
+    }
+
+    m_delayedWrites++;
+    return promise::newPromise([&](promise::Defer& defer) {
+        std::weak_ptr<bool> lifetime = m_lifetime;
+        m_timers->Schedule(release - now, [this, lifetime, defer, buffer = std::move(buffer)]() mutable {
+            if (lifetime.expired())
             {
-                defer.resolve();
+                BotBufferPool::ReleaseBuffer(std::move(buffer));
+                return defer.reject();
             }
+            m_delayedWrites--;
+            QueueWriteNow(std::move(buffer))
+                .then([defer]() { defer.resolve(); })
+                .fail([defer]() { defer.reject(); });
         });
     });
 }
 
-promise::Promise BotSocket::ReadCString()
+promise::Promise BotSocket::QueueWriteNow(std::vector<uint8_t>&& buffer)
 {
-    std::string* str = new std::string("");
-    return promise::doWhile([=](promise::DeferLoop& loop) {
-        ReadPOD<uint8_t>().then([=](uint8_t value) {
-            if (value == '\0')
-            {
-                std::string s = *str;
-                delete str;
-                return loop.doBreak(s);
-            }
-            else
-            {
-                str->push_back(value);
-                return loop.doContinue();
-            }
-        })
-        .fail([=](){
-            delete str;
-            loop.reject();
-        });
+    if (m_ioChannel)
+    {
+        // the buffer leaves this thread (or the pool) here, so pending headers are encrypted now
+        BotArc4Engine::FlushCurrent();
+        // completion is not reported back across threads, the packet counts as sent once queued
+        if (m_ioClosed)
+        {
+            BotBufferPool::ReleaseBuffer(std::move(buffer));
+            return promise::reject();
+        }
+        m_ioChannel->Send(m_ioConnection, std::move(buffer));
+        return promise::resolve();
+    }
+
+    return promise::newPromise([&](promise::Defer& defer) {
+        m_writeQueue.push_back({ std::move(buffer), defer });
+        ScheduleFlush();
     });
 }
 
-promise::Promise BotSocket::ReadString(uint32_t size)
+void BotSocket::ScheduleFlush()
 {
-    char* arr = new char[size];
-    return promise::newPromise([=](promise::Defer& defer) {
-        boost::asio::async_read(m_socket, boost::asio::buffer(arr, size), [=](const boost::system::error_code& ec, auto _) {
-            std::string str(arr, size);
-            delete[] arr;
+    if (m_flushScheduled)
+    {
+        return;
+    }
+    m_flushScheduled = true;
+    std::weak_ptr<bool> lifetime = m_lifetime;
+    boost::asio::post(m_socket.get_executor(), [this, lifetime]() {
+        if (lifetime.expired())
+        {
+            return;
+        }
+        m_flushScheduled = false;
+        Flush();
+    });
+}
+
+void BotSocket::Flush()
+{
+    if (m_writing || m_writeQueue.empty())
+    {
+        return;
+    }
+
+    // headers queued by WorldPacket::Send are encrypted for every socket of the thread at once
+    BotArc4Engine::FlushCurrent();
+    m_writing = true;
+    std::swap(m_writeQueue, m_writesInFlight);
+    m_writeBuffers.clear();
+    for (QueuedWrite const& write : m_writesInFlight)
+    {
+        m_writeBuffers.push_back(boost::asio::buffer(write.m_buffer));
+    }
+
+    std::weak_ptr<bool> lifetime = m_lifetime;
+    boost::asio::async_write(m_socket, m_writeBuffers, [this, lifetime](const boost::system::error_code& ec, auto _) {
+        if (lifetime.expired())
+        {
+            return;
+        }
+        m_writing = false;
+        // continuations may queue new writes, so detach the finished batch first
+        std::vector<QueuedWrite> finished;
+        std::swap(finished, m_writesInFlight);
+        for (QueuedWrite& write : finished)
+        {
             if (ec.failed())
             {
-                defer.reject(ec);
+                write.m_defer.reject(ec);
             }
             else
             {
-                defer.resolve(str);
+                write.m_defer.resolve();
             }
-            });
-        });
+            BotBufferPool::ReleaseBuffer(std::move(write.m_buffer));
+        }
+        Flush();
+    });
+}
+
+promise::Promise BotSocket::ReadCString()
+{
+    // bytes already searched for the terminator, so each read only scans new data
+    std::shared_ptr<size_t> scanned = std::make_shared<size_t>(0);
+    return promise::doWhile([this, scanned](promise::DeferLoop& loop) {
+        char const* start = reinterpret_cast<char const*>(m_readBuffer.GetReadPointer());
+        void const* end = memchr(start + *scanned, 0, m_readBuffer.GetActiveSize() - *scanned);
+        if (end)
+        {
+            std::string value(start, static_cast<char const*>(end));
+            m_readBuffer.ReadCompleted(value.size() + 1);
+            return loop.doBreak(value);
+        }
+        *scanned = m_readBuffer.GetActiveSize();
+        ReadSome()
+            .then([=]() { loop.doContinue(); })
+            .fail([=]() { loop.reject(); });
+    });
+}
+
+promise::Promise BotSocket::ReadString(uint32_t size)
+{
+    return Fill(size).then([this, size]() {
+        std::string value(reinterpret_cast<char const*>(m_readBuffer.GetReadPointer()), size);
+        m_readBuffer.ReadCompleted(size);
+        return promise::resolve(value);
+    });
 }
@@ -17,6 +17,8 @@
 #pragma once
 
 #include "ARC4.h"
+#include "BotReceiveBuffer.h"
+#include "BotBufferPool.h"
 
 #include <boost/asio.hpp>
 #include <promise.hpp>
@@ -24,58 +26,173 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
+#include <cstring>
+#include <random>
+
+class BotIoChannel;
+struct BotIoCommand;
+class BotTimerWheel;
+
+// Simulated bad network, applied inside the socket so it needs no netem or root.
+// Like netem it delays what the bot sends, received data is only rate limited and stalled.
+// Times are in ms, with the BotThread tick as resolution.
+struct BotImpairment
+{
+    // added to every write, so it adds to the round trip
+    uint32_t m_latency = 0;
+    // random extra latency up to this
+    uint32_t m_jitter = 0;
+    // bytes per second in each direction, 0 is unlimited
+    uint32_t m_bandwidth = 0;
+    // chance (0-1) that a read or write stalls for m_stallTime
+    float m_stallChance = 0.0f;
+    uint32_t m_stallTime = 0;
+    static BotImpairment Create(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime);
+};
+
+// A connection taken off one io_context, to be wrapped again on another
+struct BotSocketHandle
+{
+    boost::asio::ip::tcp::socket::native_handle_type m_handle = {};
+    bool m_v6 = false;
+};
 
 class BotSocket
 {
 public:
-    boost::asio::ip::tcp::socket m_socket;
-    boost::asio::ip::tcp::resolver m_resolver;
     BotSocket(boost::asio::io_context& ctx);
+    BotSocket(BotSocket const&) = delete;
+    BotSocket& operator=(BotSocket const&) = delete;
     void Close();
-    promise::Promise Connect(std::string const& ip, std::string const& port);
+    bool IsOpen() const;
+    // No write is queued, delayed or in flight
+    bool IsIdle() const;
+    // A read (or the delay before it) is pending
+    bool IsReading() const;
+    // Stops the pending read, which fails unless it already got data. Reads after this
+    // fail right away until Rebind. Cancels writes too, so only call it while idle.
+    void CancelRead();
+    std::weak_ptr<bool> GetLifetime() const;
+    // Pipelined mode: gives the connection (and any unframed bytes) to an io thread.
+    // Writes are forwarded to it from then on, reads arrive as BotIoEvents.
+    void HandOff(BotIoChannel& channel, uint64_t connection, std::unique_ptr<Trinity::Crypto::ARC4> decrypt);
+    // 0 unless the socket was handed off
+    uint64_t GetIoConnection() const;
+    // The io thread reported the connection as closed
+    void OnIoClosed();
+    // Moving the socket to another BotThread: Release on the old thread once it is idle
+    // and not reading, then Rebind on the new one. Handed off sockets instead tell their
+    // io thread which channel to use with MoveIo, Release and Rebind only reset them.
+    std::optional<BotSocketHandle> Release();
+    void Rebind(boost::asio::io_context& ctx, std::optional<BotSocketHandle> const& handle);
+    // Switches to the channel of another logic thread. Returns the channel that has to get
+    // "move" once that thread knows the connection, null if the io thread already closed it.
+    BotIoChannel* MoveIo(BotIoChannel& channel, uint32_t logicThread, BotIoCommand& move);
+    // Delays reads and writes from now on, "timers" and "random" must outlive the socket.
+    // Reads done on an io thread in pipelined mode are not impaired.
+    void SetImpairment(BotImpairment const& impairment, BotTimerWheel& timers, std::minstd_rand& random);
+    void ClearImpairment();
+    // Reads as many bytes as are available (at least one) into the receive buffer
+    promise::Promise ReadSome();
+    BotReceiveBuffer& GetReadBuffer();
+    // Reads until at least "size" bytes are buffered
+    promise::Promise Fill(size_t size);
+    // Binds to a Network.SourceAddresses entry first if any are configured,
+    // "sourceHint" picks the address when they are selected by hash
+    promise::Promise Connect(std::string const& ip, std::string const& port, uint64_t sourceHint = 0);
     promise::Promise WriteVector(std::vector<uint8_t> const& value);
+    // Takes ownership of the buffer. Everything queued before control returns to the
+    // io_context (e.g. during one BotThread tick) is sent with a single gathered write.
+    promise::Promise QueueWrite(std::vector<uint8_t>&& buffer);
+    // Starts a gathered write of all queued buffers unless one is already in flight
+    void Flush();
     promise::Promise ReadVector(uint32_t size);
     promise::Promise ReadCString();
     promise::Promise ReadString(uint32_t size);
     template <typename T>
     promise::Promise WritePOD(T& value)
     {
-        unsigned char* chr = new unsigned char[sizeof(T)];
-        memcpy(chr, &value, sizeof(T));
-        return promise::newPromise([this, chr, value](promise::Defer& defer) {
-            boost::asio::async_write(m_socket, boost::asio::buffer(chr, sizeof(T)), [chr,defer](const boost::system::error_code& ec, size_t amount) {
-                delete[] chr;
-                if (ec.failed())
-                {
-                    defer.reject(ec);
-                }
-                else
-                {
-                    defer.resolve();
-                }
-            });
-        });
+        std::vector<uint8_t> buffer = BotBufferPool::AcquireBuffer(sizeof(T));
+        buffer.resize(sizeof(T));
+        memcpy(buffer.data(), &value, sizeof(T));
+        return QueueWrite(std::move(buffer));
     }
 
+    // Resolves straight from the receive buffer if enough bytes are already buffered
     template <typename T>
     promise::Promise ReadPOD()
     {
-        return promise::newPromise([this](promise::Defer& defer) {
-            T* value = new T();
-            boost::asio::async_read(m_socket, boost::asio::buffer(value, sizeof(T)), [defer, value](const boost::system::error_code& ec, std::size_t len)
-            {
-                if (ec.failed())
-                {
-                    delete value;
-                    return defer.reject(ec);
-                }
-                else
-                {
-                    T v = *value;
-                    delete value;
-                    return defer.resolve(v);
-                }
-            });
+        return Fill(sizeof(T)).then([this]() {
+            T value;
+            memcpy(&value, m_readBuffer.GetReadPointer(), sizeof(T));
+            m_readBuffer.ReadCompleted(sizeof(T));
+            return promise::resolve(value);
         });
     }
+
+#ifdef BOTS_AUTH_COROUTINES
+    // Awaitable versions of the primitives above, failures are thrown.
+    // Reads go through the receive buffer.
+    boost::asio::awaitable<void> ConnectAsync(std::string const& ip, std::string const& port, uint64_t sourceHint = 0);
+    boost::asio::awaitable<void> ReadSomeAsync();
+    boost::asio::awaitable<void> FillAsync(size_t size);
+    boost::asio::awaitable<std::string> ReadCStringAsync();
+
+    template <typename T>
+    boost::asio::awaitable<T> ReadPODAsync()
+    {
+        co_await FillAsync(sizeof(T));
+        T value;
+        memcpy(&value, m_readBuffer.GetReadPointer(), sizeof(T));
+        m_readBuffer.ReadCompleted(sizeof(T));
+        co_return value;
+    }
+#endif
+private:
+    struct QueuedWrite
+    {
+        std::vector<uint8_t> m_buffer;
+        promise::Defer m_defer;
+    };
+    void ScheduleFlush();
+    void StartRead(promise::Defer defer);
+    promise::Promise QueueWriteNow(std::vector<uint8_t>&& buffer);
+    promise::Promise QueueImpairedWrite(std::vector<uint8_t>&& buffer);
+    // How long the next read has to wait for the bandwidth cap or a stall
+    uint64_t GetReadDelay();
+    void OnImpairedRead(size_t size);
+    bool RollStall();
+    void ConnectResolved(boost::asio::ip::tcp::resolver::results_type const& results, uint64_t sourceHint, promise::Defer defer);
+    // Opens and binds the socket if a source address is configured, returns the endpoint to connect to
+    std::optional<boost::asio::ip::tcp::endpoint> BindSource(boost::asio::ip::tcp::resolver::results_type const& results, uint64_t sourceHint, boost::system::error_code& ec);
+    std::vector<QueuedWrite> m_writeQueue;
+    std::vector<QueuedWrite> m_writesInFlight;
+    std::vector<boost::asio::const_buffer> m_writeBuffers;
+    bool m_flushScheduled = false;
+    bool m_writing = false;
+    // impaired writes waiting in the timer wheel
+    uint32_t m_delayedWrites = 0;
+    bool m_reading = false;
+    bool m_readCancelled = false;
+    BotReceiveBuffer m_readBuffer;
+    // Header bytes at the read position that the world packet framer already decrypted
+    uint32_t m_decryptedHeaderBytes = 0;
+    // Completion handlers only touch the socket if this is still alive
+    std::shared_ptr<bool> m_lifetime;
+    BotIoChannel* m_ioChannel = nullptr;
+    uint64_t m_ioConnection = 0;
+    bool m_ioClosed = false;
+    std::optional<BotImpairment> m_impairment;
+    BotTimerWheel* m_timers = nullptr;
+    std::minstd_rand* m_random = nullptr;
+    // delayed writes are released in order, no earlier than this
+    uint64_t m_writeReleaseTime = 0;
+    uint64_t m_readResumeTime = 0;
+    friend class WorldPacket;
+public:
+    // Declared last so they are destroyed first: cancelled handlers still reference the
+    // write queues and the read buffer above
+    boost::asio::ip::tcp::socket m_socket;
+    boost::asio::ip::tcp::resolver m_resolver;
 };
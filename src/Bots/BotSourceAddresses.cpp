@@ -0,0 +1,71 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotSourceAddresses.h"
+#include "BotLogging.h"
+
+#include "Config.h"
+
+#include <algorithm>
+#include <sstream>
+
+BotSourceAddressPool* BotSourceAddressPool::instance()
+{
+    static BotSourceAddressPool pool;
+    return &pool;
+}
+
+void BotSourceAddressPool::Load()
+{
+    m_addresses.clear();
+    std::string list = sConfigMgr->GetStringDefault("Network.SourceAddresses", "");
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::istringstream stream(list);
+    std::string token;
+    while (stream >> token)
+    {
+        boost::system::error_code ec;
+        boost::asio::ip::address address = boost::asio::ip::make_address(token, ec);
+        if (ec.failed())
+        {
+            BOT_LOG_ERROR("network", "Invalid source address \"%s\" in Network.SourceAddresses", token.c_str());
+            continue;
+        }
+        m_addresses.push_back(address);
+    }
+
+    std::string selection = sConfigMgr->GetStringDefault("Network.SourceAddressSelection", "roundrobin");
+    m_byHash = selection == "hash";
+    if (!m_byHash && selection != "roundrobin")
+    {
+        BOT_LOG_ERROR("network", "Unknown Network.SourceAddressSelection \"%s\", using roundrobin", selection.c_str());
+    }
+
+    if (m_addresses.size() > 0)
+    {
+        BOT_LOG_INFO("network", "Binding bot connections to %u source addresses (%s)", uint32_t(m_addresses.size()), m_byHash ? "hash" : "roundrobin");
+    }
+}
+
+std::optional<boost::asio::ip::address> BotSourceAddressPool::Select(uint64_t hint)
+{
+    if (m_addresses.empty())
+    {
+        return std::nullopt;
+    }
+    uint64_t index = m_byHash ? hint : m_next.fetch_add(1, std::memory_order_relaxed);
+    return m_addresses[index % m_addresses.size()];
+}
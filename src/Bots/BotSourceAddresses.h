@@ -0,0 +1,43 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <boost/asio/ip/address.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Local addresses outgoing bot connections are bound to (Network.SourceAddresses).
+// Each source address has its own ephemeral port range, so spreading bots over
+// several addresses lifts the ~28k connection limit towards a single server endpoint.
+class BotSourceAddressPool
+{
+public:
+    static BotSourceAddressPool* instance();
+    // Reads the address list from the config, only called before bots start
+    void Load();
+    // Returns no address if the pool is empty, in which case the os picks one
+    std::optional<boost::asio::ip::address> Select(uint64_t hint);
+private:
+    std::vector<boost::asio::ip::address> m_addresses;
+    bool m_byHash = false;
+    std::atomic<uint64_t> m_next = 0;
+};
+
+#define sBotSourceAddressPool BotSourceAddressPool::instance()
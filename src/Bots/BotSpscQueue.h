@@ -0,0 +1,100 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Unbounded lock-free queue for exactly one producer and one consumer thread.
+// Items live in linked blocks, the consumer frees a block once it moved past it.
+template <typename T, size_t BlockSize = 256>
+class BotSpscQueue
+{
+public:
+    BotSpscQueue()
+        : m_head(new Block())
+    {
+        m_tail = m_head;
+    }
+
+    BotSpscQueue(BotSpscQueue const&) = delete;
+    BotSpscQueue& operator=(BotSpscQueue const&) = delete;
+
+    ~BotSpscQueue()
+    {
+        while (m_head)
+        {
+            Block* next = m_head->m_next.load(std::memory_order_relaxed);
+            delete m_head;
+            m_head = next;
+        }
+    }
+
+    // Producer thread only
+    void Push(T&& value)
+    {
+        if (m_tailIndex == BlockSize)
+        {
+            Block* block = new Block();
+            m_tail->m_next.store(block, std::memory_order_release);
+            m_tail = block;
+            m_tailIndex = 0;
+        }
+        m_tail->m_items[m_tailIndex] = std::move(value);
+        m_tail->m_written.store(++m_tailIndex, std::memory_order_release);
+    }
+
+    // Consumer thread only, returns false if the queue is empty
+    bool Pop(T& value)
+    {
+        for (;;)
+        {
+            if (m_headIndex < m_head->m_written.load(std::memory_order_acquire))
+            {
+                value = std::move(m_head->m_items[m_headIndex++]);
+                return true;
+            }
+            if (m_headIndex < BlockSize)
+            {
+                return false;
+            }
+            Block* next = m_head->m_next.load(std::memory_order_acquire);
+            if (!next)
+            {
+                return false;
+            }
+            delete m_head;
+            m_head = next;
+            m_headIndex = 0;
+        }
+    }
+private:
+    struct Block
+    {
+        std::array<T, BlockSize> m_items;
+        std::atomic<size_t> m_written = 0;
+        std::atomic<Block*> m_next = nullptr;
+    };
+    // consumer side
+    alignas(64) Block* m_head;
+    size_t m_headIndex = 0;
+    // producer side
+    alignas(64) Block* m_tail;
+    size_t m_tailIndex = 0;
+};
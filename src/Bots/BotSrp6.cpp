@@ -0,0 +1,575 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotSrp6.h"
+#include "BotAuth.h"
+#include "BotProfile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <optional>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// a * b + c + d, which always fits in 128 bits
+static inline uint64_t MulAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t& hi)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    low += c;
+    high += low < c;
+    low += d;
+    high += low < d;
+    hi = high;
+    return low;
+#else
+    unsigned __int128 result = (unsigned __int128)a * b + c + d;
+    hi = uint64_t(result >> 64);
+    return uint64_t(result);
+#endif
+}
+
+static void LimbsFromBytes(uint8_t const* data, size_t size, uint64_t* limbs, size_t limbCount)
+{
+    std::fill(limbs, limbs + limbCount, 0);
+    for (size_t i = 0; i < size && i < limbCount * 8; ++i)
+    {
+        limbs[i / 8] |= uint64_t(data[i]) << ((i % 8) * 8);
+    }
+}
+
+BotUInt256 BotUInt256::FromBytes(uint8_t const* data, size_t size)
+{
+    BotUInt256 value;
+    LimbsFromBytes(data, size, value.m_limbs.data(), 4);
+    return value;
+}
+
+void BotUInt256::ToBytes(std::array<uint8_t, 32>& bytes) const
+{
+    for (size_t i = 0; i < 32; ++i)
+    {
+        bytes[i] = uint8_t(m_limbs[i / 8] >> ((i % 8) * 8));
+    }
+}
+
+size_t BotUInt256::GetNumBytes() const
+{
+    for (size_t i = 4; i-- > 0;)
+    {
+        if (m_limbs[i])
+        {
+            size_t bytes = 8;
+            while (!(m_limbs[i] >> ((bytes - 1) * 8)))
+            {
+                --bytes;
+            }
+            return i * 8 + bytes;
+        }
+    }
+    return 0;
+}
+
+bool BotUInt256::IsZero() const
+{
+    return (m_limbs[0] | m_limbs[1] | m_limbs[2] | m_limbs[3]) == 0;
+}
+
+bool BotUInt256::operator==(BotUInt256 const& other) const
+{
+    return m_limbs == other.m_limbs;
+}
+
+bool BotUInt256::operator!=(BotUInt256 const& other) const
+{
+    return m_limbs != other.m_limbs;
+}
+
+// a >= b
+static bool GreaterOrEqual(BotUInt256 const& a, BotUInt256 const& b)
+{
+    for (size_t i = 4; i-- > 0;)
+    {
+        if (a.m_limbs[i] != b.m_limbs[i])
+        {
+            return a.m_limbs[i] > b.m_limbs[i];
+        }
+    }
+    return true;
+}
+
+// a -= b, returns the borrow
+static uint64_t SubInPlace(BotUInt256& a, BotUInt256 const& b)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t diff = a.m_limbs[i] - b.m_limbs[i];
+        uint64_t nextBorrow = (a.m_limbs[i] < b.m_limbs[i]) | (diff < borrow);
+        a.m_limbs[i] = diff - borrow;
+        borrow = nextBorrow;
+    }
+    return borrow;
+}
+
+// a += b, returns the carry
+static uint64_t AddInPlace(BotUInt256& a, BotUInt256 const& b)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t sum = a.m_limbs[i] + carry;
+        uint64_t nextCarry = sum < carry;
+        sum += b.m_limbs[i];
+        nextCarry |= sum < b.m_limbs[i];
+        a.m_limbs[i] = sum;
+        carry = nextCarry;
+    }
+    return carry;
+}
+
+//
+// BotSha1
+//
+
+static inline uint32_t RotateLeft(uint32_t value, uint32_t bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+BotSha1::BotSha1()
+    : m_state({ 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 })
+{
+}
+
+BotSha1& BotSha1::Update(uint8_t const* data, size_t size)
+{
+    size_t used = size_t(m_size % 64);
+    m_size += size;
+    if (used > 0)
+    {
+        size_t take = std::min(64 - used, size);
+        memcpy(m_block.data() + used, data, take);
+        data += take;
+        size -= take;
+        if (used + take < 64)
+        {
+            return *this;
+        }
+        Transform(m_block.data());
+    }
+    for (; size >= 64; data += 64, size -= 64)
+    {
+        Transform(data);
+    }
+    if (size > 0)
+    {
+        memcpy(m_block.data(), data, size);
+    }
+    return *this;
+}
+
+BotSha1& BotSha1::Update(std::string const& value)
+{
+    return Update(reinterpret_cast<uint8_t const*>(value.data()), value.size());
+}
+
+BotSha1::Digest BotSha1::Finalize()
+{
+    uint64_t bits = m_size * 8;
+    static uint8_t const padding[64] = { 0x80 };
+    size_t used = size_t(m_size % 64);
+    Update(padding, used < 56 ? 56 - used : 120 - used);
+    uint8_t length[8];
+    for (size_t i = 0; i < 8; ++i)
+    {
+        length[i] = uint8_t(bits >> (56 - i * 8));
+    }
+    Update(length, 8);
+
+    Digest digest;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        digest[i] = uint8_t(m_state[i / 4] >> (24 - (i % 4) * 8));
+    }
+    return digest;
+}
+
+void BotSha1::Transform(uint8_t const* block)
+{
+    uint32_t w[80];
+    for (size_t i = 0; i < 16; ++i)
+    {
+        w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) | (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+    }
+    for (size_t i = 16; i < 80; ++i)
+    {
+        w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3], e = m_state[4];
+    for (size_t i = 0; i < 80; ++i)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = RotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+}
+
+//
+// BotMontgomery256
+//
+
+BotMontgomery256::BotMontgomery256(BotUInt256 const& n)
+    : m_n(n)
+{
+    if (!IsValid())
+    {
+        return;
+    }
+
+    // Newton iteration, each step doubles the correct low bits (3 to start with for odd n)
+    uint64_t inv = n.m_limbs[0];
+    for (int i = 0; i < 5; ++i)
+    {
+        inv *= 2 - n.m_limbs[0] * inv;
+    }
+    m_nInv = 0 - inv;
+
+    BotUInt256 r2;
+    r2.m_limbs[0] = 1;
+    for (int i = 0; i < 512; ++i)
+    {
+        r2 = Add(r2, r2);
+    }
+    m_r2 = r2;
+
+    BotUInt256 one;
+    one.m_limbs[0] = 1;
+    m_one = Mul(one, m_r2);
+}
+
+bool BotMontgomery256::IsValid() const
+{
+    return (m_n.m_limbs[0] & 1) && (m_n.m_limbs[0] > 1 || m_n.m_limbs[1] || m_n.m_limbs[2] || m_n.m_limbs[3]);
+}
+
+BotUInt256 const& BotMontgomery256::GetModulus() const
+{
+    return m_n;
+}
+
+BotUInt256 BotMontgomery256::Add(BotUInt256 const& a, BotUInt256 const& b) const
+{
+    BotUInt256 sum = a;
+    if (AddInPlace(sum, b) || GreaterOrEqual(sum, m_n))
+    {
+        SubInPlace(sum, m_n);
+    }
+    return sum;
+}
+
+BotUInt256 BotMontgomery256::Sub(BotUInt256 const& a, BotUInt256 const& b) const
+{
+    BotUInt256 diff = a;
+    if (SubInPlace(diff, b))
+    {
+        AddInPlace(diff, m_n);
+    }
+    return diff;
+}
+
+// a * b / R mod N (CIOS), both below R and one of them below N
+BotUInt256 BotMontgomery256::Mul(BotUInt256 const& a, BotUInt256 const& b) const
+{
+    uint64_t t[6] = {};
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t carry = 0;
+        uint64_t hi;
+        for (size_t j = 0; j < 4; ++j)
+        {
+            t[j] = MulAdd(a.m_limbs[j], b.m_limbs[i], t[j], carry, hi);
+            carry = hi;
+        }
+        t[4] += carry;
+        t[5] = t[4] < carry;
+
+        uint64_t m = t[0] * m_nInv;
+        MulAdd(m, m_n.m_limbs[0], t[0], 0, carry);
+        for (size_t j = 1; j < 4; ++j)
+        {
+            t[j - 1] = MulAdd(m, m_n.m_limbs[j], t[j], carry, hi);
+            carry = hi;
+        }
+        t[3] = t[4] + carry;
+        t[4] = t[5] + (t[3] < carry);
+    }
+
+    BotUInt256 result;
+    std::copy(t, t + 4, result.m_limbs.begin());
+    if (t[4] || GreaterOrEqual(result, m_n))
+    {
+        SubInPlace(result, m_n);
+    }
+    return result;
+}
+
+BotUInt256 BotMontgomery256::Reduce(BotUInt256 const& value) const
+{
+    BotUInt256 one;
+    one.m_limbs[0] = 1;
+    return Mul(Mul(value, m_r2), one);
+}
+
+BotUInt256 BotMontgomery256::ModExp(BotUInt256 const& base, uint64_t const* exponent, size_t size) const
+{
+    // fixed 4 bit window
+    std::array<BotUInt256, 16> table;
+    table[0] = m_one;
+    table[1] = Mul(base, m_r2);
+    for (size_t i = 2; i < 16; ++i)
+    {
+        table[i] = Mul(table[i - 1], table[1]);
+    }
+
+    BotUInt256 result = m_one;
+    bool started = false;
+    for (size_t limb = size; limb-- > 0;)
+    {
+        for (int shift = 60; shift >= 0; shift -= 4)
+        {
+            uint32_t window = uint32_t(exponent[limb] >> shift) & 0xF;
+            if (started)
+            {
+                result = Mul(result, result);
+                result = Mul(result, result);
+                result = Mul(result, result);
+                result = Mul(result, result);
+                if (window)
+                {
+                    result = Mul(result, table[window]);
+                }
+            }
+            else if (window)
+            {
+                result = table[window];
+                started = true;
+            }
+        }
+    }
+
+    BotUInt256 one;
+    one.m_limbs[0] = 1;
+    return Mul(result, one);
+}
+
+//
+// BotSrp6
+//
+
+std::array<uint8_t, 20> BotSrp6::ComputeX(std::string const& username, std::string const& password, std::array<uint8_t, 32> const& salt)
+{
+    BotSha1 sha;
+    auto updateUpper = [&](std::string const& value) {
+        for (char c : value)
+        {
+            uint8_t upper = uint8_t(std::toupper(uint8_t(c)));
+            sha.Update(&upper, 1);
+        }
+    };
+    updateUpper(username);
+    sha.Update(reinterpret_cast<uint8_t const*>(":"), 1);
+    updateUpper(password);
+    return BotSha1::GetDigestOf(salt, sha.Finalize());
+}
+
+// N is the same for every login against a server, so its constants are kept per thread
+static BotMontgomery256 const& GetMontgomery(BotUInt256 const& n)
+{
+    thread_local std::optional<BotMontgomery256> cached;
+    if (!cached.has_value() || cached->GetModulus() != n)
+    {
+        cached.emplace(n);
+    }
+    return cached.value();
+}
+
+bool BotSrp6::ComputeVerifier(ServerAuthChallenge const& challenge, std::array<uint8_t, 20> const& x, BotUInt256& verifier)
+{
+    BotMontgomery256 const& mont = GetMontgomery(BotUInt256::FromBytes(challenge.m_N.data(), 32));
+    if (!mont.IsValid())
+    {
+        return false;
+    }
+    uint64_t xLimbs[3];
+    LimbsFromBytes(x.data(), x.size(), xLimbs, 3);
+    verifier = mont.ModExp(BotUInt256::FromBytes(&challenge.m_g, 1), xLimbs, 3);
+    return true;
+}
+
+bool BotSrp6::ComputeProof(std::string const& username, ServerAuthChallenge const& challenge, std::array<uint8_t, 20> const& x, BotUInt256 const* verifier, std::array<uint8_t, 19> const& a, Proof& proof)
+{
+    BotUInt256 n = BotUInt256::FromBytes(challenge.m_N.data(), 32);
+    BotMontgomery256 const& mont = GetMontgomery(n);
+    if (!mont.IsValid())
+    {
+        return false;
+    }
+    BotUInt256 g = BotUInt256::FromBytes(&challenge.m_g, 1);
+    BotUInt256 B = BotUInt256::FromBytes(challenge.m_B.data(), 32);
+
+    uint64_t aLimbs[3];
+    LimbsFromBytes(a.data(), a.size(), aLimbs, 3);
+    BotUInt256 A = mont.ModExp(g, aLimbs, 3);
+    if (A.IsZero())
+    {
+        return false;
+    }
+    A.ToBytes(proof.m_A);
+    proof.m_aSize = A.GetNumBytes();
+
+    BotUInt256 gx;
+    uint64_t xLimbs[3];
+    LimbsFromBytes(x.data(), x.size(), xLimbs, 3);
+    if (verifier)
+    {
+        gx = *verifier;
+    }
+    else
+    {
+        gx = mont.ModExp(g, xLimbs, 3);
+    }
+
+    // numbers are hashed without their high zero bytes, like MergeVec(BigNumber)
+    size_t bSize = B.GetNumBytes();
+    std::array<uint8_t, 20> u = BotSha1().Update(proof.m_A.data(), proof.m_aSize).Update(challenge.m_B.data(), bSize).Finalize();
+
+    // exponent a + u * x, up to 321 bits
+    uint64_t uLimbs[3];
+    LimbsFromBytes(u.data(), u.size(), uLimbs, 3);
+    uint64_t exponent[6] = {};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        uint64_t carry = 0;
+        uint64_t hi;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            exponent[i + j] = MulAdd(uLimbs[i], xLimbs[j], exponent[i + j], carry, hi);
+            carry = hi;
+        }
+        exponent[i + 3] = carry;
+    }
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 6; ++i)
+    {
+        uint64_t sum = exponent[i] + carry;
+        carry = sum < carry;
+        if (i < 3)
+        {
+            sum += aLimbs[i];
+            carry |= sum < aLimbs[i];
+        }
+        exponent[i] = sum;
+    }
+
+    // (B + k * (N - g^x)) % N with k = 3
+    BotUInt256 kv = mont.Sub(BotUInt256(), gx);
+    kv = mont.Add(mont.Add(kv, kv), kv);
+    BotUInt256 S = mont.ModExp(mont.Add(mont.Reduce(B), kv), exponent, 6);
+
+    std::array<uint8_t, 32> sData;
+    S.ToBytes(sData);
+    std::array<uint8_t, 16> half;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        half[i] = sData[i * 2];
+    }
+    std::array<uint8_t, 20> keyHash = BotSha1::GetDigestOf(half);
+    for (size_t i = 0; i < 20; ++i)
+    {
+        proof.m_keyData[i * 2] = keyHash[i];
+    }
+    for (size_t i = 0; i < 16; ++i)
+    {
+        half[i] = sData[i * 2 + 1];
+    }
+    keyHash = BotSha1::GetDigestOf(half);
+    for (size_t i = 0; i < 20; ++i)
+    {
+        proof.m_keyData[i * 2 + 1] = keyHash[i];
+    }
+    size_t keySize = proof.m_keyData.size();
+    while (keySize > 0 && proof.m_keyData[keySize - 1] == 0)
+    {
+        --keySize;
+    }
+
+    std::array<uint8_t, 20> gnHash = BotSha1().Update(challenge.m_N.data(), n.GetNumBytes()).Finalize();
+    std::array<uint8_t, 20> gHash = BotSha1().Update(&challenge.m_g, g.GetNumBytes()).Finalize();
+    for (size_t i = 0; i < 20; ++i)
+    {
+        gnHash[i] ^= gHash[i];
+    }
+
+    proof.m_m1Hash = BotSha1()
+        .Update(gnHash)
+        .Update(BotSha1::GetDigestOf(username))
+        .Update(challenge.m_salt)
+        .Update(proof.m_A.data(), proof.m_aSize)
+        .Update(challenge.m_B.data(), bSize)
+        .Update(proof.m_keyData.data(), keySize)
+        .Finalize();
+    proof.m_m2Hash = BotSha1()
+        .Update(proof.m_A.data(), proof.m_aSize)
+        .Update(proof.m_m1Hash)
+        .Update(proof.m_keyData)
+        .Finalize();
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct ServerAuthChallenge;
+
+// Unsigned 256-bit integer, little endian 64-bit limbs
+struct BotUInt256
+{
+    std::array<uint64_t, 4> m_limbs = {};
+    // Little endian bytes, at most 32
+    static BotUInt256 FromBytes(uint8_t const* data, size_t size);
+    void ToBytes(std::array<uint8_t, 32>& bytes) const;
+    // Bytes without the most significant zeros, like BigNumber::GetNumBytes
+    size_t GetNumBytes() const;
+    bool IsZero() const;
+    bool operator==(BotUInt256 const& other) const;
+    bool operator!=(BotUInt256 const& other) const;
+};
+
+// Streaming SHA1 that does not allocate, for hashing a transcript piece by piece
+class BotSha1
+{
+public:
+    using Digest = std::array<uint8_t, 20>;
+    BotSha1();
+    BotSha1& Update(uint8_t const* data, size_t size);
+    BotSha1& Update(std::string const& value);
+    template <size_t N>
+    BotSha1& Update(std::array<uint8_t, N> const& value)
+    {
+        return Update(value.data(), N);
+    }
+    Digest Finalize();
+    template <typename ... Args>
+    static Digest GetDigestOf(Args const& ... args)
+    {
+        BotSha1 sha;
+        (sha.Update(args), ...);
+        return sha.Finalize();
+    }
+private:
+    void Transform(uint8_t const* block);
+    std::array<uint32_t, 5> m_state;
+    std::array<uint8_t, 64> m_block;
+    uint64_t m_size = 0;
+};
+
+// Montgomery arithmetic modulo a fixed odd 256-bit N, everything lives on the stack
+class BotMontgomery256
+{
+public:
+    explicit BotMontgomery256(BotUInt256 const& n);
+    // Montgomery form needs an odd modulus
+    bool IsValid() const;
+    BotUInt256 const& GetModulus() const;
+    // value mod N
+    BotUInt256 Reduce(BotUInt256 const& value) const;
+    BotUInt256 Add(BotUInt256 const& a, BotUInt256 const& b) const;
+    BotUInt256 Sub(BotUInt256 const& a, BotUInt256 const& b) const;
+    // base^exponent mod N, the exponent is "size" little endian limbs
+    BotUInt256 ModExp(BotUInt256 const& base, uint64_t const* exponent, size_t size) const;
+private:
+    BotUInt256 Mul(BotUInt256 const& a, BotUInt256 const& b) const;
+    BotUInt256 m_n;
+    // -N^-1 mod 2^64
+    uint64_t m_nInv = 0;
+    // R^2 mod N, R = 2^256
+    BotUInt256 m_r2;
+    BotUInt256 m_one;
+};
+
+// Client side of the SRP6 logon, the same math as the BigNumber version in BotAuth.cpp
+class BotSrp6
+{
+public:
+    struct Proof
+    {
+        std::array<uint8_t, 32> m_A;
+        // significant bytes of A, which is sent without its high zeros
+        size_t m_aSize;
+        std::array<uint8_t, 20> m_m1Hash;
+        std::array<uint8_t, 20> m_m2Hash;
+        std::array<uint8_t, 40> m_keyData;
+    };
+    // SHA1(salt, SHA1(USERNAME:PASSWORD))
+    static std::array<uint8_t, 20> ComputeX(std::string const& username, std::string const& password, std::array<uint8_t, 32> const& salt);
+    // g^x mod N, false if N can not be used
+    static bool ComputeVerifier(ServerAuthChallenge const& challenge, std::array<uint8_t, 20> const& x, BotUInt256& verifier);
+    // "verifier" is g^x mod N if already known, "a" the client's private value.
+    // False if the challenge needs the generic path.
+    static bool ComputeProof(std::string const& username, ServerAuthChallenge const& challenge, std::array<uint8_t, 20> const& x, BotUInt256 const* verifier, std::array<uint8_t, 19> const& a, Proof& proof);
+};
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotTimerWheel.h"
+
+#include <algorithm>
+
+BotTimerWheel::BotTimerWheel(uint32_t resolutionMs, uint32_t slotCount)
+    : m_resolution(std::max(resolutionMs, 1u))
+    , m_slots(std::max(slotCount, 1u))
+{
+}
+
+BotTimerWheel::TimerId BotTimerWheel::Schedule(uint64_t delayMs, std::function<void()> callback)
+{
+    TimerId id = m_nextId++;
+    uint64_t deadline = m_now + delayMs;
+    // round up, and never into a slot that was already processed
+    uint64_t tick = std::max((deadline + m_resolution - 1) / m_resolution, m_tick + 1);
+    m_slots[tick % m_slots.size()].push_back(id);
+    m_timers.emplace(id, Timer{ deadline, std::move(callback) });
+    return id;
+}
+
+void BotTimerWheel::Cancel(TimerId id)
+{
+    // the slot entry is dropped lazily when its slot comes around
+    m_timers.erase(id);
+}
+
+void BotTimerWheel::Advance(uint64_t nowMs)
+{
+    if (m_now == 0)
+    {
+        m_tick = nowMs / m_resolution;
+    }
+    m_now = std::max(m_now, nowMs);
+
+    uint64_t target = m_now / m_resolution;
+    // after a stall longer than a full turn every slot only needs one visit
+    uint64_t first = std::max(m_tick + 1, target >= m_slots.size() ? target - m_slots.size() + 1 : 0);
+    for (uint64_t tick = first; tick <= target; ++tick)
+    {
+        std::vector<TimerId>& slot = m_slots[tick % m_slots.size()];
+        size_t kept = 0;
+        for (TimerId id : slot)
+        {
+            auto itr = m_timers.find(id);
+            if (itr == m_timers.end())
+            {
+                continue;
+            }
+            if (itr->second.m_deadline <= m_now)
+            {
+                m_due.push_back(id);
+            }
+            else
+            {
+                slot[kept++] = id;
+            }
+        }
+        slot.resize(kept);
+    }
+    m_tick = std::max(m_tick, target);
+
+    std::vector<TimerId> due;
+    std::swap(due, m_due);
+    for (TimerId id : due)
+    {
+        // an earlier callback may have cancelled it
+        auto itr = m_timers.find(id);
+        if (itr == m_timers.end())
+        {
+            continue;
+        }
+        std::function<void()> callback = std::move(itr->second.m_callback);
+        m_timers.erase(itr);
+        callback();
+    }
+}
+
+uint64_t BotTimerWheel::GetTime() const
+{
+    return m_now;
+}
+
+size_t BotTimerWheel::GetSize() const
+{
+    return m_timers.size();
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Hashed timer wheel shared by everything a BotThread schedules (timeouts, reconnects, ...).
+// Advanced from the thread's tick, so timers fire with tick resolution.
+class BotTimerWheel
+{
+public:
+    using TimerId = uint64_t;
+    BotTimerWheel(uint32_t resolutionMs, uint32_t slotCount = 1024);
+    // Returns an id that is never 0
+    TimerId Schedule(uint64_t delayMs, std::function<void()> callback);
+    void Cancel(TimerId id);
+    // Fires every timer due at "nowMs", callbacks may schedule and cancel timers
+    void Advance(uint64_t nowMs);
+    uint64_t GetTime() const;
+    size_t GetSize() const;
+private:
+    struct Timer
+    {
+        uint64_t m_deadline;
+        std::function<void()> m_callback;
+    };
+    uint32_t m_resolution;
+    std::vector<std::vector<TimerId>> m_slots;
+    std::unordered_map<TimerId, Timer> m_timers;
+    uint64_t m_now = 0;
+    uint64_t m_tick = 0;
+    TimerId m_nextId = 1;
+    std::vector<TimerId> m_due;
+};
@@ -0,0 +1,221 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotWarmPool.h"
+#include "BotSocket.h"
+#include "BotMgr.h"
+#include "BotProfile.h"
+#include "BotLoginRamp.h"
+#include "BotAccounts.h"
+#include "BotCredentialCache.h"
+#include "BotLogging.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// set from the console thread by loginbench
+static std::atomic<uint32_t> poolSize = 0;
+static std::atomic<uint32_t> poolMaxIdle = 10000;
+
+BotWarmPool::BotWarmPool(boost::asio::io_context& context)
+    : m_context(context)
+{
+}
+
+BotWarmPool::~BotWarmPool() = default;
+
+void BotWarmPool::Load()
+{
+    poolSize = std::max(sConfigMgr->GetIntDefault("Bots.WarmPoolSize", 0), 0);
+    poolMaxIdle = std::max(sConfigMgr->GetIntDefault("Bots.WarmPoolMaxIdle", 10000), 0);
+}
+
+uint32_t BotWarmPool::GetSize()
+{
+    return poolSize;
+}
+
+void BotWarmPool::SetSize(uint32_t size)
+{
+    poolSize = size;
+}
+
+void BotWarmPool::Update(uint64_t now, std::vector<Login> const& logins)
+{
+    std::map<Login, uint32_t> wanted;
+    for (Login const& login : logins)
+    {
+        wanted[login]++;
+    }
+
+    for (auto itr = m_entries.begin(); itr != m_entries.end();)
+    {
+        std::vector<std::shared_ptr<Entry>>& entries = itr->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](std::shared_ptr<Entry> const& entry) {
+            return entry->m_ready && (!entry->m_socket->IsOpen() || now - entry->m_connectedTime > poolMaxIdle);
+        }), entries.end());
+        itr = entries.empty() && wanted.find(itr->first) == wanted.end() ? m_entries.erase(itr) : std::next(itr);
+    }
+
+    for (auto& [login, count] : wanted)
+    {
+        std::string const& authserver = login.first;
+        std::vector<std::shared_ptr<Entry>>& entries = m_entries[login];
+        while (entries.size() < count)
+        {
+            std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+            entry->m_socket = std::make_unique<BotSocket>(m_context);
+            std::weak_ptr<Entry> weak = entry;
+            entries.push_back(entry);
+            entry->m_socket->Connect(authserver, "3724", login.second)
+                .then([weak]() {
+                    if (std::shared_ptr<Entry> entry = weak.lock())
+                    {
+                        entry->m_ready = true;
+                        entry->m_connectedTime = std::chrono::duration_cast<std::chrono::milliseconds>
+                            (std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+                    }
+                })
+                .fail([this, weak, login]() {
+                    std::shared_ptr<Entry> entry = weak.lock();
+                    if (!entry)
+                    {
+                        return;
+                    }
+                    BOT_LOG_DEBUG("WarmPool", "Could not connect to %s", login.first.c_str());
+                    std::vector<std::shared_ptr<Entry>>& entries = m_entries[login];
+                    entries.erase(std::remove(entries.begin(), entries.end(), entry), entries.end());
+                });
+        }
+    }
+}
+
+bool BotWarmPool::Take(std::string const& authserver, uint64_t sourceHint, BotSocket& socket)
+{
+    auto itr = m_entries.find({ authserver, sourceHint });
+    if (itr == m_entries.end())
+    {
+        return false;
+    }
+    std::vector<std::shared_ptr<Entry>>& entries = itr->second;
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        if (!(*entry)->m_ready)
+        {
+            ++entry;
+            continue;
+        }
+        std::unique_ptr<BotSocket> pooled = std::move((*entry)->m_socket);
+        entry = entries.erase(entry);
+        if (IsAlive(*pooled))
+        {
+            socket.m_socket = std::move(pooled->m_socket);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BotWarmPool::IsAlive(BotSocket& socket)
+{
+    if (!socket.IsOpen())
+    {
+        return false;
+    }
+    // nothing to read yet is what a live authserver connection looks like, data or eof is not
+    boost::system::error_code ec;
+    uint8_t byte;
+    socket.m_socket.non_blocking(true, ec);
+    socket.m_socket.receive(boost::asio::buffer(&byte, 1), boost::asio::ip::tcp::socket::message_peek, ec);
+    bool alive = ec == boost::asio::error::would_block;
+    socket.m_socket.non_blocking(false, ec);
+    return alive;
+}
+
+static BotLoginRamp::Stats RunLoginBenchmarkPass(std::vector<BotAccount>& accounts, std::string const& events)
+{
+    // every pass pays for x and the verifier, otherwise the later one gets cache hits the other had not
+    sBotCredentialCache->Clear();
+    sBotLoginRamp->ResetStats();
+    for (BotAccount& account : accounts)
+    {
+        StartBot(account.GetUsername(), account.GetPassword(), events);
+    }
+
+    // bots that give up do not report back, so the pass ends after a while without progress
+    BotLoginRamp::Stats stats = sBotLoginRamp->GetStats();
+    uint32_t lastDone = 0;
+    auto lastProgress = std::chrono::steady_clock::now();
+    while (stats.m_succeeded + stats.m_failed < accounts.size())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stats = sBotLoginRamp->GetStats();
+        uint32_t done = stats.m_succeeded + stats.m_failed;
+        if (done != lastDone)
+        {
+            lastDone = done;
+            lastProgress = std::chrono::steady_clock::now();
+        }
+        else if (std::chrono::steady_clock::now() - lastProgress > std::chrono::seconds(60))
+        {
+            BOT_LOG_ERROR("loginbench", "No login finished for 60s, ending the pass early");
+            break;
+        }
+    }
+
+    for (BotAccount& account : accounts)
+    {
+        StopBot(account.GetUsername());
+    }
+    // give the worldserver time to log the characters out before the accounts are used again
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+    return stats;
+}
+
+void RunLoginBenchmark(uint32_t count, uint32_t poolSize, std::string const& events)
+{
+    std::vector<BotAccount> accounts = GetAllBotAccounts();
+    if (accounts.size() < count)
+    {
+        BOT_LOG_ERROR("loginbench", "accounts.json only has %u accounts", uint32_t(accounts.size()));
+        return;
+    }
+    accounts.erase(accounts.begin() + count, accounts.end());
+
+    uint32_t configured = BotWarmPool::GetSize();
+    // the second round runs the passes the other way around, so neither always goes first
+    for (uint32_t round = 0; round < 2; ++round)
+    {
+        for (uint32_t size : round == 0 ? std::vector<uint32_t>{ 0u, poolSize } : std::vector<uint32_t>{ poolSize, 0u })
+        {
+            BotWarmPool::SetSize(size);
+            BotLoginRamp::Stats stats = RunLoginBenchmarkPass(accounts, events);
+            BOT_LOG_INFO("loginbench", "Round %u, warm pool %u: %u in world, %u failed, time to world avg %u ms, p50 %u ms, p95 %u ms, max %u ms"
+                , round + 1
+                , size
+                , stats.m_succeeded
+                , stats.m_failed
+                , stats.m_worldAverage
+                , stats.m_worldP50
+                , stats.m_worldP95
+                , stats.m_worldMax
+            );
+        }
+    }
+    BotWarmPool::SetSize(configured);
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class BotSocket;
+
+// Auth connections a BotThread opens ahead of the logins at the front of its queue,
+// so an admitted bot can start the challenge right away instead of paying the
+// resolve and tcp handshake first. Off unless Bots.WarmPoolSize is set.
+class BotWarmPool
+{
+public:
+    BotWarmPool(boost::asio::io_context& context);
+    ~BotWarmPool();
+    // Authserver and source hint of the next logins in the queue, at most GetSize()
+    using Login = std::pair<std::string, uint64_t>;
+    // Connections idle for longer than Bots.WarmPoolMaxIdle are closed.
+    void Update(uint64_t now, std::vector<Login> const& logins);
+    // Moves a live pooled connection to "authserver" into "socket". It was opened with
+    // "sourceHint", so it is bound to the address the bot would have picked itself.
+    bool Take(std::string const& authserver, uint64_t sourceHint, BotSocket& socket);
+
+    static void Load();
+    // Connections per thread, 0 disables the pool
+    static uint32_t GetSize();
+    static void SetSize(uint32_t size);
+private:
+    struct Entry
+    {
+        std::unique_ptr<BotSocket> m_socket;
+        bool m_ready = false;
+        uint64_t m_connectedTime = 0;
+    };
+    // The server may have closed the connection while it sat in the pool
+    static bool IsAlive(BotSocket& socket);
+    boost::asio::io_context& m_context;
+    std::map<Login, std::vector<std::shared_ptr<Entry>>> m_entries;
+};
+
+// Starts "count" bots from accounts.json without the warm pool and with "poolSize", twice in
+// alternating order, and logs time-to-in-world percentiles measured from StartBot
+void RunLoginBenchmark(uint32_t count, uint32_t poolSize, std::string const& events);
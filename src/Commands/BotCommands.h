@@ -19,6 +19,10 @@
 #include "BotCommandMgr.h"
 #include "BotMgr.h"
 #include "BotProfile.h"
+#include "BotIoBackend.h"
+#include "BotAuth.h"
+#include "BotArc4.h"
+#include "BotWarmPool.h"
 
 void BotCommandMgr::RegisterBaseCommands()
 {
@@ -43,4 +47,93 @@ void BotCommandMgr::RegisterBaseCommands()
             })
             ;
     }
-}
\ No newline at end of file
+
+    { // Migrate
+        std::string USERNAME = "username";
+        std::string THREAD = "thread";
+
+        CreateCommand("migrate")
+            .SetDescription("Moves a bot to another bot thread, logged in bots keep their connections")
+            .AddStringParam(USERNAME)
+            .AddNumberParam(THREAD)
+            .SetCallback([=](BotCommandArguments const& args) {
+                sBotMgr->MigrateBot(args.get_string(USERNAME), uint32_t(args.get_number(THREAD)));
+            })
+            ;
+    }
+
+    { // Stats
+        CreateCommand("stats")
+            .SetDescription("Prints login queue depth, handshake latency and per-thread bot counts, tick cost and buffer pool usage")
+            .SetCallback([=](BotCommandArguments const& args) {
+                sBotMgr->LogStats();
+            })
+            ;
+    }
+
+    { // IoBench
+        std::string CONNECTIONS = "connections";
+        std::string MESSAGES = "messages";
+        std::string SIZE = "size";
+
+        CreateCommand("iobench")
+            .SetDescription("Measures loopback round trips on the io backend this build uses (connections 0 runs 1k/10k/30k)")
+            .AddNumberParam(CONNECTIONS, 0)
+            .AddNumberParam(MESSAGES, 100)
+            .AddNumberParam(SIZE, 64)
+            .SetCallback([=](BotCommandArguments const& args) {
+                RunIoBenchmark(
+                      uint32_t(args.get_number(CONNECTIONS))
+                    , uint32_t(args.get_number(MESSAGES))
+                    , uint32_t(args.get_number(SIZE))
+                );
+            })
+            ;
+    }
+
+    { // SRP6 benchmark
+        std::string COUNT = "count";
+
+        CreateCommand("srpbench")
+            .SetDescription("Measures login proofs per second on one core, BigNumber against the fixed-width path")
+            .AddNumberParam(COUNT, 10000)
+            .SetCallback([=](BotCommandArguments const& args) {
+                RunSrp6Benchmark(uint32_t(args.get_number(COUNT)));
+            })
+            ;
+    }
+
+    { // ARC4 benchmark
+        std::string STREAMS = "streams";
+        std::string PACKETS = "packets";
+
+        CreateCommand("arc4bench")
+            .SetDescription("Measures world header encryption, one EVP call per header against the batched BotArc4Engine")
+            .AddNumberParam(STREAMS, 10000)
+            .AddNumberParam(PACKETS, 100)
+            .SetCallback([=](BotCommandArguments const& args) {
+                RunArc4Benchmark(uint32_t(args.get_number(STREAMS)), uint32_t(args.get_number(PACKETS)));
+            })
+            ;
+    }
+
+    { // Login benchmark
+        std::string COUNT = "count";
+        std::string POOL = "pool";
+        std::string EVENTS = "events";
+
+        CreateCommand("loginbench")
+            .SetDescription("Logs in the first accounts with and without the warm pool, twice in alternating order, and prints time to world percentiles")
+            .AddNumberParam(COUNT, 100)
+            .AddNumberParam(POOL, 32)
+            .AddStringParam(EVENTS, ROOT_EVENT_NAME)
+            .SetCallback([=](BotCommandArguments const& args) {
+                RunLoginBenchmark(
+                      uint32_t(args.get_number(COUNT))
+                    , uint32_t(args.get_number(POOL))
+                    , args.get_string(EVENTS)
+                );
+            })
+            ;
+    }
+}
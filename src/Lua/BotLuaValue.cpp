@@ -0,0 +1,106 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BotLuaValue.h"
+
+#include <algorithm>
+
+BotLuaValue BotLuaValue::Copy(sol::object const& object)
+{
+    std::vector<void const*> parents;
+    return Copy(object, parents);
+}
+
+BotLuaValue BotLuaValue::Copy(sol::object const& object, std::vector<void const*>& parents)
+{
+    BotLuaValue value;
+    switch (object.get_type())
+    {
+        case sol::type::boolean:
+            value.m_value = object.as<bool>();
+            break;
+        case sol::type::number:
+        {
+#if LUA_VERSION_NUM >= 503
+            // integers stay integers, e.g. for table keys
+            object.push();
+            bool integer = lua_isinteger(object.lua_state(), -1);
+            lua_pop(object.lua_state(), 1);
+            if (integer)
+            {
+                value.m_value = object.as<int64_t>();
+                break;
+            }
+#endif
+            value.m_value = object.as<double>();
+            break;
+        }
+        case sol::type::string:
+            value.m_value = object.as<std::string>();
+            break;
+        case sol::type::table:
+        {
+            void const* pointer = object.pointer();
+            if (std::find(parents.begin(), parents.end(), pointer) != parents.end())
+            {
+                break;
+            }
+            parents.push_back(pointer);
+            Table table;
+            for (auto& [key, child] : object.as<sol::table>())
+            {
+                BotLuaValue copiedKey = Copy(key, parents);
+                BotLuaValue copiedChild = Copy(child, parents);
+                if (std::holds_alternative<std::monostate>(copiedKey.m_value) || std::holds_alternative<std::monostate>(copiedChild.m_value))
+                {
+                    continue;
+                }
+                table.m_keys.push_back(std::move(copiedKey));
+                table.m_values.push_back(std::move(copiedChild));
+            }
+            parents.pop_back();
+            value.m_value = std::move(table);
+            break;
+        }
+        default:
+            break;
+    }
+    return value;
+}
+
+sol::object BotLuaValue::Create(sol::state_view state) const
+{
+    return std::visit([&](auto const& value) -> sol::object {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::monostate>)
+        {
+            return sol::make_object(state.lua_state(), sol::lua_nil);
+        }
+        else if constexpr (std::is_same_v<T, Table>)
+        {
+            sol::table table = state.create_table();
+            for (size_t i = 0; i < value.m_keys.size(); ++i)
+            {
+                table[value.m_keys[i].Create(state)] = value.m_values[i].Create(state);
+            }
+            return table;
+        }
+        else
+        {
+            return sol::make_object(state.lua_state(), value);
+        }
+    }, m_value);
+}
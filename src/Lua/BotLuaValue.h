@@ -0,0 +1,40 @@
+/*
+ * This file is part of the wotlk-bots project <https://github.com/tswow/wotlk-bots>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <sol/sol.hpp>
+
+#include <string>
+#include <variant>
+#include <vector>
+
+// A lua value copied out of its state, so it can be rebuilt in another one (e.g. the
+// data of a bot that moves to another BotThread). Functions, userdata and coroutines
+// cannot leave their state and are dropped, so are tables that contain themselves.
+class BotLuaValue
+{
+public:
+    static BotLuaValue Copy(sol::object const& object);
+    sol::object Create(sol::state_view state) const;
+private:
+    struct Table
+    {
+        std::vector<BotLuaValue> m_keys;
+        std::vector<BotLuaValue> m_values;
+    };
+    static BotLuaValue Copy(sol::object const& object, std::vector<void const*>& parents);
+    std::variant<std::monostate, bool, int64_t, double, std::string, Table> m_value;
+};
@@ -19,6 +19,7 @@
 #include "BotProfile.h"
 #include "BotMutable.h"
 #include "BotLuaShared.h"
+#include "BotLuaValue.h"
 #include "BotLogging.h"
 #include "Config.h"
 #include "BehaviorTree.h"
@@ -89,6 +90,8 @@ void BotProfileLua::LoadLibraries()
     auto LBotProfile = m_state.new_usertype<BotProfile>("BotProfile");
     LBotProfile.set_function("Register", &BotProfile::Register);
     LBotProfile.set_function("SetBehaviorRoot", &BotProfile::SetBehaviorRoot);
+    LBotProfile.set_function("SetReconnectPolicy", &BotProfile::SetReconnectPolicy);
+    LBotProfile.set_function("SetImpairment", &BotProfile::SetImpairment);
     LBotProfile.set_function("OnWorldPacket", sol::overload(&BotProfile::LOnWorldPacket, &BotProfile::_LOnWorldPacket,&BotProfile::LidOnWorldPacket));
     LBotProfile.set_function("OnLoad", &BotProfile::LOnLoad);
     LBotProfile.set_function("OnAuthChallenge", &BotProfile::LOnAuthChallenge);
@@ -159,6 +162,8 @@ void BotProfileLua::LoadLibraries()
     LBot.set_function("GetPassword", &Bot::GetPassword);
     LBot.set_function("IsLoggedIn", &Bot::IsLoggedIn);
     LBot.set_function("GetThreadID", &Bot::GetThreadID);
+    LBot.set_function("SetImpairment", &Bot::SetImpairment);
+    LBot.set_function("ClearImpairment", &Bot::ClearImpairment);
 
     LBot.set_function("SetData", [this](Bot* bot, std::string const& key, sol::object value) {
         InitializeBotData(bot);
@@ -191,3 +196,12 @@ void BotProfileLua::InitializeBotData(Bot* bot)
         bot->m_data = m_state.create_table();
     }
 }
+
+void BotProfileLua::SetBotData(Bot* bot, BotLuaValue const& data)
+{
+    sol::object value = data.Create(m_state);
+    if (value.get_type() == sol::type::table)
+    {
+        bot->m_data = value.as<sol::table>();
+    }
+}
@@ -23,6 +23,7 @@
 
 class Bot;
 class BotThread;
+class BotLuaValue;
 class BotProfileLua : public BotLuaState
 {
     BotThread* m_thread;
@@ -31,4 +32,6 @@ protected:
     void LoadLibraries() override;
 public:
     BotProfileLua(BotThread* thread);
+    // Data a bot brought from another thread's lua state
+    void SetBotData(Bot* bot, BotLuaValue const& data);
 };
\ No newline at end of file
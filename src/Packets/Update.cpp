@@ -1,5 +1,6 @@
 #include "Update.h"
 #include "BotPacket.h"
+#include "BotBufferPool.h"
 
 #include <sol/sol.hpp>
 
@@ -499,11 +500,15 @@ int inflateBuf(const void* src, int srcLen, void* dst, int dstLen) {
 
 UpdateDataPacket UpdateDataPacket::ReadCompressed(WorldPacket& packet)
 {
-    // todo: this is a lot of copies
     uint32 decompressedSize = packet.ReadUInt32();
-    std::vector<uint8_t> compressed = packet.ReadBytes(packet.GetPayloadSize() - 4);
-    std::vector<uint8_t> decompressed(decompressedSize);
-    int res = inflateBuf(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    uint32 compressedSize = packet.GetPayloadSize() - 4;
+    uint8 const* compressed = packet.ReadRaw(compressedSize);
+    // inflate straight behind an opcode so the result can be read through a packet view
+    std::vector<uint8_t> decompressed = BotBufferPool::AcquireBuffer(decompressedSize + 2);
+    decompressed.resize(decompressedSize + 2);
+    uint16 opcode = uint16(Opcodes::SMSG_COMPRESSED_UPDATE_OBJECT);
+    memcpy(decompressed.data(), &opcode, sizeof(uint16));
+    int res = inflateBuf(compressed, compressedSize, decompressed.data() + 2, decompressedSize);
     switch (res)
     {
     case Z_BUF_ERROR:
@@ -516,9 +521,10 @@ UpdateDataPacket UpdateDataPacket::ReadCompressed(WorldPacket& packet)
         throw std::runtime_error("zlib received corrupted data");
         break;
     }
-    WorldPacket decompressedPacket(Opcodes::SMSG_COMPRESSED_UPDATE_OBJECT, decompressed.size());
-    decompressedPacket.WriteBytes(decompressed);
-    return Read(decompressedPacket);
+    WorldPacket decompressedPacket(decompressed.data(), decompressed.size());
+    UpdateDataPacket result = Read(decompressedPacket);
+    BotBufferPool::ReleaseBuffer(std::move(decompressed));
+    return result;
 }
 
 uint32 UpdateDataPacket::EntryCount()
@@ -43,6 +43,21 @@ struct TSEvent
 				return m_cxx_callbacks.size() > 0 || m_lua_callbacks.size() > 0;
 		}
 
+		// How many callbacks fire for "id", including the ones without an id
+		size_t count(uint32_t id) const
+		{
+				size_t count = m_cxx_callbacks.size() + m_lua_callbacks.size();
+				if (id < m_id_cxx_callbacks.size())
+				{
+						count += m_id_cxx_callbacks[id].size();
+				}
+				if (id < m_id_lua_callbacks.size())
+				{
+						count += m_id_lua_callbacks[id].size();
+				}
+				return count;
+		}
+
 		void extend(TSEvent<C> const& evt)
 		{
 				for (C callback : evt.m_cxx_callbacks)
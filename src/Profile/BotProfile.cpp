@@ -18,6 +18,7 @@
 #include "BehaviorTree.h"
 #include "Update.h"
 
+#include <algorithm>
 #include <set>
 #include <map>
 #include <memory>
@@ -164,6 +165,23 @@ BotProfile BotProfile::SetBehaviorRoot(Node<Bot, std::monostate, std::monostate>
     return *this;
 }
 
+BotProfile BotProfile::SetReconnectPolicy(uint32_t maxAttempts, uint32_t baseDelay, uint32_t maxDelay, float jitter)
+{
+    BotReconnectPolicy policy;
+    policy.m_maxAttempts = maxAttempts;
+    policy.m_baseDelay = std::max(baseDelay, 1u);
+    policy.m_maxDelay = std::max(maxDelay, policy.m_baseDelay);
+    policy.m_jitter = std::clamp(jitter, 0.0f, 1.0f);
+    m_storage->m_reconnect = policy;
+    return *this;
+}
+
+BotProfile BotProfile::SetImpairment(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime)
+{
+    m_storage->m_impairment = BotImpairment::Create(latency, jitter, bandwidth, stallChance, stallTime);
+    return *this;
+}
+
 BotProfile BotProfileMgr::GetEvents(std::string const& events)
 {
     auto itr = m_namedEvents.find(events);
@@ -29,6 +29,7 @@
 #include <map>
 #include <set>
 #include <cstdint>
+#include <optional>
 #include <variant>
 
 class Bot;
@@ -43,6 +44,17 @@ class Node;
 template <typename C, typename LC, typename DC>
 class BehaviorTreeContext;
 
+// How a bot retries after a failed login, delays are in milliseconds
+struct BotReconnectPolicy
+{
+    // 0 retries forever
+    uint32_t m_maxAttempts = 0;
+    uint32_t m_baseDelay = 1000;
+    uint32_t m_maxDelay = 60000;
+    // fraction of the backoff that is randomized (0-1), spreads out bots that failed together
+    float m_jitter = 0.5f;
+};
+
 class BotProfileData
 {
 public:
@@ -62,6 +74,8 @@ private:
     std::vector<BotProfileData*> m_children;
     BotProfileMgr* m_mgr;
     Node<Bot, std::monostate, std::monostate>* m_root = nullptr;
+    std::optional<BotReconnectPolicy> m_reconnect;
+    std::optional<BotImpairment> m_impairment;
     void apply_extensions(BotProfileData* parent)
     {
         EXTEND_EVENT(this, parent, OnWorldPacket);
@@ -74,6 +88,15 @@ private:
         EXTEND_EVENT(this, parent, OnWorldAuthChallenge);
         EXTEND_EVENT(this, parent, OnWorldAuthResponse);
         EXTEND_EVENT(this, parent, OnLoggedIn);
+        // parents are visited nearest first
+        if (!m_reconnect.has_value())
+        {
+            m_reconnect = parent->m_reconnect;
+        }
+        if (!m_impairment.has_value())
+        {
+            m_impairment = parent->m_impairment;
+        }
     }
     friend class BotProfileMgr;
     friend class BotProfile;
@@ -97,6 +120,9 @@ public:
     BotProfile OnUpdateData(std::function<void(Bot& bot, UpdateDataPacket packet)> callback);
     BotProfile OnMovementPacket(std::function<void(Bot& bot, MovementPacket packet)> callback);
     BotProfile SetBehaviorRoot(Node<Bot, std::monostate, std::monostate>* root);
+    BotProfile SetReconnectPolicy(uint32_t maxAttempts, uint32_t baseDelay, uint32_t maxDelay, float jitter);
+    // Simulated network conditions for this profile's bots, see BotImpairment
+    BotProfile SetImpairment(uint32_t latency, uint32_t jitter, uint32_t bandwidth, float stallChance, uint32_t stallTime);
     BotProfile Register(std::string const& mod, std::string const& name);
     BotProfile();
     bool IsLoaded();
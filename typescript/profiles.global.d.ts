@@ -50,6 +50,14 @@ declare class Bot {
     HasData(key: string): boolean
     IsLoggedIn(): boolean
     GetThreadID(): number
+    /**
+     * Simulates a bad network for this bot, overriding its profile.
+     * latency/jitter/stallTime are in ms, bandwidth in bytes per second (0 is unlimited)
+     * and stallChance (0-1) is rolled for every read and write.
+     */
+    SetImpairment(latency: number, jitter: number, bandwidth: number, stallChance: number, stallTime: number): Bot
+    /** Goes back to the profile's impairment, if any */
+    ClearImpairment(): Bot
 }
 
 
@@ -79,6 +87,14 @@ declare class WorldAuthResponse {}
 
 declare class BotProfile {
     SetBehaviorRoot(node: RootNode<Bot,void,void>)
+    /**
+     * Retries failed logins after min(maxDelay, baseDelay * 2^attempt) ms,
+     * with a random "jitter" fraction (0-1) of that taken off.
+     * maxAttempts 0 retries forever.
+     */
+    SetReconnectPolicy(maxAttempts: number, baseDelay: number, maxDelay: number, jitter: number): BotProfile
+    /** Simulates a bad network for this profile's bots, see Bot.SetImpairment */
+    SetImpairment(latency: number, jitter: number, bandwidth: number, stallChance: number, stallTime: number): BotProfile
     OnLoad(callback: (bot: Bot) => void): BotProfile;
     OnLoggedIn(callback: (bot: Bot) => void): BotProfile;
     OnAuthChallenge(callback: (bot: Bot, packet: AuthPacket, cancel: BotMutable<boolean>) => void): BotProfile